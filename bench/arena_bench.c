@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../include/arena.h"
+#include "../include/classifier.h"
+#include "../include/stats_util.h"
+
+//=============================================================================
+// CONSTANTS:
+//=============================================================================
+#define NUM_ROUNDS      5
+#define NUM_SAMPLES     (4 * 1000 * 1000)
+#define NUM_TRAIN       (NUM_SAMPLES / 4)
+
+//=============================================================================
+// MALLOC COUNTING:
+//
+// The bench is linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+// (see the Makefile), so every allocation made by the bench, the arena, the
+// classifier and the stats object goes through these wrappers and is counted
+// the same way for both paths.
+//=============================================================================
+static size_t num_mallocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    num_mallocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    num_mallocs++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    num_mallocs++;
+    return __real_realloc(ptr, size);
+}
+
+//-----------------------------------------------------------------------------
+// Returns the current monotonic time in seconds.
+//-----------------------------------------------------------------------------
+static double now(void)
+{
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return tp.tv_sec + tp.tv_nsec * 1e-9;
+}
+
+//-----------------------------------------------------------------------------
+// One round on the heap, the way main allocated before the arena: the stats
+// and classifier objects are malloc'd, and one array sized for every sample
+// holds the training samples. The other samples are classified directly.
+//-----------------------------------------------------------------------------
+static void run_heap_round(void)
+{
+    struct stats_t        *stats      = create_stats();
+    struct gaussian_occ_t *classifier = create_classifier();
+    double                *train      = (double *) malloc(sizeof(double) * NUM_SAMPLES);
+
+    if ((stats == NULL) || (classifier == NULL) || (train == NULL))
+    {
+        printf("Error: unable to allocate enough memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < NUM_SAMPLES; i++)
+    {
+        if (i < NUM_TRAIN)
+        {
+            train[i] = 100 + (i % 37);
+            if (i == NUM_TRAIN - 1)
+                classifier->train(classifier, train, NUM_TRAIN);
+        }
+        else
+        {
+            stats->add_stat(stats, 1, classifier->classify(classifier, 100 + (i % 37)));
+        }
+    }
+
+    free(train);
+    delete_classifier(classifier);
+    delete_stats(stats);
+}
+
+//-----------------------------------------------------------------------------
+// One round with the objects and the training samples allocated from the
+// arena, the way main allocates now.
+//-----------------------------------------------------------------------------
+static void run_arena_round(struct arena_t *arena)
+{
+    struct sample_buf_t    samples;
+    struct stats_t        *stats;
+    struct gaussian_occ_t *classifier;
+
+    arena->reset(arena);
+
+    stats      = create_stats_in(arena);
+    classifier = create_classifier_in(arena);
+
+    if ((stats == NULL) || (classifier == NULL) || (init_sample_buf(&samples, arena, NUM_TRAIN) == -1))
+    {
+        printf("Error: unable to allocate enough memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < NUM_SAMPLES; i++)
+    {
+        if (i < NUM_TRAIN)
+        {
+            if (sample_buf_push(&samples, 100 + (i % 37)) == -1)
+            {
+                printf("Error: unable to allocate enough memory\n");
+                exit(EXIT_FAILURE);
+            }
+            if (i == NUM_TRAIN - 1)
+                classifier->train(classifier, samples.samples, samples.len);
+        }
+        else
+        {
+            stats->add_stat(stats, 1, classifier->classify(classifier, 100 + (i % 37)));
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Prints one row of the table.
+//-----------------------------------------------------------------------------
+static void report(const char *path, int round, size_t mallocs, double seconds)
+{
+    printf("%-6s %-6d %12d %14zu %18.8f %12.2f\n",
+        path,
+        round,
+        NUM_SAMPLES,
+        mallocs,
+        (double) mallocs / NUM_SAMPLES,
+        seconds * 1e9 / NUM_SAMPLES);
+}
+
+//=============================================================================
+// MAIN:
+//=============================================================================
+int main(void)
+{
+    struct arena_t *arena;
+    size_t          mallocs;
+    double          start;
+
+    printf("%-6s %-6s %12s %14s %18s %12s\n", "path", "round", "samples", "malloc calls", "mallocs/sample", "ns/sample");
+
+    for (int round = 0; round < NUM_ROUNDS; round++)
+    {
+        mallocs = num_mallocs;
+        start   = now();
+        run_heap_round();
+        report("heap", round, num_mallocs - mallocs, now() - start);
+    }
+
+    mallocs = num_mallocs;
+    if ((arena = create_arena(ARENA_DEFAULT_CHUNK_SIZE)) == NULL)
+    {
+        printf("Error: unable to allocate enough memory\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("arena created with %zu malloc calls\n", num_mallocs - mallocs);
+
+    for (int round = 0; round < NUM_ROUNDS; round++)
+    {
+        mallocs = num_mallocs;
+        start   = now();
+        run_arena_round(arena);
+        report("arena", round, num_mallocs - mallocs, now() - start);
+    }
+
+    delete_arena(arena);
+    return 0;
+}
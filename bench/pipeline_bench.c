@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+#include "../include/pipeline.h"
+#include "../include/registry.h"
+#include "../include/mem_sampler.h"
+
+//=============================================================================
+// CONSTANTS:
+//=============================================================================
+#define NUM_CHILDREN    2048
+#define MAX_THREADS     64
+#define WARMUP_MS       500
+#define WARMUP_ROUNDS   2
+#define RUN_SECONDS     2
+#define CHUNK_SIZE      32
+#define QUEUE_SIZE      16384
+
+//-----------------------------------------------------------------------------
+// Returns the current monotonic time in seconds.
+//-----------------------------------------------------------------------------
+static double now(void)
+{
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return tp.tv_sec + tp.tv_nsec * 1e-9;
+}
+
+//=============================================================================
+// MAIN:
+//=============================================================================
+int main(void)
+{
+    pid_t                     children[NUM_CHILDREN];
+    struct registry_t        *registry;
+    struct pipeline_t        *pipeline;
+    struct pipeline_stats_t   start;
+    struct pipeline_stats_t   end;
+    struct pipeline_config_t  config;
+    long                      cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long             submitted_rounds;
+    double                    start_time;
+    double                    seconds;
+    double                    base_rate = 0;
+    double                    rate;
+    int                       slot;
+
+    //-------------------------------------------------------------------------
+    // Spawn one idle child per tracked process. The pipeline keys processes
+    // by pid, so every tracked process has to be a distinct one.
+    //-------------------------------------------------------------------------
+    fflush(stdout);
+    for (int i = 0; i < NUM_CHILDREN; i++)
+    {
+        if ((children[i] = fork()) < 0)
+        {
+            printf("Error: unable to fork process.");
+            exit(EXIT_FAILURE);
+        }
+        else if (children[i] == 0)
+        {
+            pause();
+            exit(EXIT_SUCCESS);
+        }
+    }
+
+    if (((registry = create_registry(1)) == NULL) || ((slot = registry->add(registry, "bench")) == -1))
+    {
+        printf("Error: unable to allocate enough memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Reads are counted only inside a steady-state window that starts after
+    // every process has been submitted, the samplers have completed a few
+    // full rounds, and a warmup has passed.
+    printf("%d processes tracked, %d ms warmup, %d s measured per run\n",
+        NUM_CHILDREN, WARMUP_MS, RUN_SECONDS);
+    printf("%-6s %-8s %14s %10s %10s %10s\n", "cpus", "threads", "reads/s", "speedup", "rounds", "steals");
+
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2)
+    {
+        // A zero sample rate samples every process in every round, and rounds
+        // run back to back.
+        memset(&config, 0, sizeof(config));
+        config.num_samplers        = threads;
+        config.max_tracked         = NUM_CHILDREN;
+        config.max_workloads       = 1;
+        config.queue_size          = QUEUE_SIZE;
+        config.chunk_size          = CHUNK_SIZE;
+        config.rollup_thresh_pages = MEM_SAMPLER_NO_ROLLUP;
+
+        if ((pipeline = create_pipeline(registry, &config, NULL)) == NULL)
+        {
+            printf("Error: unable to start a pipeline with %d samplers\n", threads);
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = 0; i < NUM_CHILDREN; i++)
+            pipeline->submit(pipeline, children[i], slot);
+
+        // Wait for the submitted processes to be in every round.
+        pipeline->get_stats(pipeline, &start);
+        submitted_rounds = start.rounds;
+        usleep(WARMUP_MS * 1000);
+        do
+        {
+            usleep(1000);
+            pipeline->get_stats(pipeline, &start);
+        } while (start.rounds < submitted_rounds + WARMUP_ROUNDS);
+
+        start_time = now();
+        sleep(RUN_SECONDS);
+        pipeline->get_stats(pipeline, &end);
+        seconds = now() - start_time;
+        delete_pipeline(pipeline);
+
+        rate = (end.reads - start.reads) / seconds;
+        if (threads == 1)
+            base_rate = rate;
+
+        printf("%-6ld %-8d %14.0f %9.2fx %10lu %10lu\n", cpus, threads, rate, rate / base_rate,
+            end.rounds - start.rounds, end.steals - start.steals);
+    }
+
+    //-------------------------------------------------------------------------
+    // Clean up
+    //-------------------------------------------------------------------------
+    for (int i = 0; i < NUM_CHILDREN; i++)
+    {
+        kill(children[i], SIGTERM);
+        waitpid(children[i], NULL, 0);
+    }
+
+    delete_registry(registry);
+    return 0;
+}
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+#include "../include/mem_util.h"
+#include "../include/mem_sampler.h"
+
+//=============================================================================
+// CONSTANTS:
+//=============================================================================
+#define NUM_CHILDREN    16
+#define IDLE_US         100000
+#define BURST_STEPS     16
+#define STEP_BYTES      (256 * 1024)
+#define STEP_US         200
+#define HOLD_US         1000
+#define EXEC_ARG        "exec-child"
+#define EXEC_BYTES      (64 * 1024 * 1024)
+
+//=============================================================================
+// HELPERS:
+//=============================================================================
+
+//-----------------------------------------------------------------------------
+// A mostly idle child: it sits still, grows in a short burst, holds its peak
+// for a moment, releases it and sits still again. The peak it reached is
+// written to fd.
+//-----------------------------------------------------------------------------
+static void bursty_child(int fd)
+{
+    struct statm_t  statm = { 0 };
+    char           *steps[BURST_STEPS];
+
+    usleep(IDLE_US);
+
+    for (int i = 0; i < BURST_STEPS; i++)
+    {
+        steps[i] = mmap(NULL, STEP_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (steps[i] != MAP_FAILED)
+            memset(steps[i], 1, STEP_BYTES);
+        usleep(STEP_US);
+    }
+
+    parse_statm(getpid(), &statm);
+    usleep(HOLD_US);
+
+    for (int i = 0; i < BURST_STEPS; i++)
+    {
+        if (steps[i] != MAP_FAILED)
+            munmap(steps[i], STEP_BYTES);
+    }
+
+    usleep(IDLE_US);
+
+    if (write(fd, &statm.data, sizeof(statm.data)) != sizeof(statm.data))
+        exit(EXIT_FAILURE);
+}
+
+//-----------------------------------------------------------------------------
+// Runs NUM_CHILDREN bursty children one after the other and samples each
+// with the given rate settings, like ./main does.
+//
+// @param reads on return, total number of statm reads.
+// @param error on return, mean relative error of the measured peaks.
+//-----------------------------------------------------------------------------
+static void run(const struct sample_rate_config_t *config, unsigned long *reads, double *error)
+{
+    struct sample_rate_t  rate;
+    struct statm_t        statm = { 0 };
+    unsigned long         true_peak;
+    unsigned long         peak;
+    long                  interval;
+    pid_t                 pid;
+    int                   fds[2];
+    int                   fd_statm;
+
+    *reads = 0;
+    *error = 0;
+
+    // Flush so the table isn't duplicated into every forked child.
+    fflush(stdout);
+
+    for (int i = 0; i < NUM_CHILDREN; i++)
+    {
+        if ((pipe(fds) == -1) || ((pid = fork()) < 0))
+        {
+            printf("Error: unable to fork process.");
+            exit(EXIT_FAILURE);
+        }
+        else if (pid == 0)
+        {
+            close(fds[0]);
+            bursty_child(fds[1]);
+            exit(EXIT_SUCCESS);
+        }
+
+        close(fds[1]);
+        fd_statm = open_statm(pid);
+        peak     = 0;
+        init_sample_rate(&rate, config);
+
+        while (!waitpid(pid, NULL, WNOHANG))
+        {
+            (*reads)++;
+
+            // A failed read leaves statm stale, so it must not move the rate.
+            if (read_statm(fd_statm, &statm) == -1)
+            {
+                usleep(rate.interval_us);
+                continue;
+            }
+
+            if (peak < statm.data)
+                peak = statm.data;
+
+            if ((interval = next_sample_interval(&rate, statm.data)) < 0)
+            {
+                waitpid(pid, NULL, 0);
+                break;
+            }
+            usleep(interval);
+        }
+
+        if (fd_statm != -1)
+            close(fd_statm);
+
+        if ((read(fds[0], &true_peak, sizeof(true_peak)) == sizeof(true_peak)) && (true_peak > 0))
+            *error += (double) (true_peak > peak ? true_peak - peak : 0) / true_peak;
+        close(fds[0]);
+    }
+
+    *error /= NUM_CHILDREN;
+}
+
+//-----------------------------------------------------------------------------
+// The program a child execs into: it touches EXEC_BYTES of fresh memory,
+// reports that it is done through fd and waits to be killed.
+//-----------------------------------------------------------------------------
+static void exec_child(int fd)
+{
+    char *mem;
+
+    if ((mem = mmap(NULL, EXEC_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+        exit(EXIT_FAILURE);
+    memset(mem, 1, EXEC_BYTES);
+
+    if (write(fd, "", 1) != 1)
+        exit(EXIT_FAILURE);
+    pause();
+    exit(EXIT_SUCCESS);
+}
+
+//-----------------------------------------------------------------------------
+// Opens a child's smaps_rollup, lets it exec into a program that uses
+// EXEC_BYTES more memory, and samples it again before and after resetting
+// the rollup. The stale file still refers to the address space the child had
+// before exec, which is gone.
+//-----------------------------------------------------------------------------
+static void run_exec(void)
+{
+    struct mem_sampler_t  sampler;
+    struct mem_sample_t   sample;
+    unsigned long         before_pss;
+    char                  fd_arg[16];
+    char                  c;
+    pid_t                 pid;
+    int                   go[2];
+    int                   ready[2];
+
+    fflush(stdout);
+
+    if ((pipe(go) == -1) || (pipe(ready) == -1) || ((pid = fork()) < 0))
+    {
+        printf("Error: unable to fork process.");
+        exit(EXIT_FAILURE);
+    }
+    else if (pid == 0)
+    {
+        close(go[1]);
+        close(ready[0]);
+        if (read(go[0], &c, 1) != 1)
+            exit(EXIT_FAILURE);
+        sprintf(fd_arg, "%d", ready[1]);
+        execl("/proc/self/exe", "sampling_bench", EXEC_ARG, fd_arg, (char *) NULL);
+        exit(EXIT_FAILURE);
+    }
+
+    close(go[0]);
+    close(ready[1]);
+
+    // A threshold of 0 reads smaps_rollup on every new resident peak.
+    if ((open_mem_sampler(&sampler, pid, 0) == -1) || (mem_sampler_read(&sampler, pid, &sample) == -1) ||
+        !sample.has_rollup)
+    {
+        printf("Error: unable to read smaps_rollup of the child\n");
+        exit(EXIT_FAILURE);
+    }
+    before_pss = sample.rollup.pss;
+
+    if ((write(go[1], "", 1) != 1) || (read(ready[0], &c, 1) != 1))
+    {
+        printf("Error: the child failed to exec\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("\nexec after smaps_rollup was opened (%d MiB touched after exec)\n", EXEC_BYTES / (1024 * 1024));
+    printf("%-24s %12s %14s\n", "rollup", "data pages", "pss kB");
+    printf("%-24s %12lu %14lu\n", "before exec", sample.statm.data, before_pss);
+
+    mem_sampler_read(&sampler, pid, &sample);
+    if (sample.has_rollup)
+        printf("%-24s %12lu %14lu\n", "stale fd", sample.statm.data, sample.rollup.pss);
+    else
+        printf("%-24s %12lu %14s\n", "stale fd", sample.statm.data, "unreadable");
+
+    reset_mem_sampler_rollup(&sampler);
+    mem_sampler_read(&sampler, pid, &sample);
+    if (sample.has_rollup)
+        printf("%-24s %12lu %14lu\n", "reset", sample.statm.data, sample.rollup.pss);
+    else
+        printf("%-24s %12lu %14s\n", "reset", sample.statm.data, "unreadable");
+
+    close_mem_sampler(&sampler);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    close(go[1]);
+    close(ready[0]);
+}
+
+//=============================================================================
+// MAIN:
+//=============================================================================
+int main(int argc, char *argv[])
+{
+    struct sample_rate_config_t configs[] = {
+        { .min_interval_us = 0,   .max_interval_us = 0,     .budget = 0   },
+        { .min_interval_us = 100, .max_interval_us = 100,   .budget = 0   },
+        { .min_interval_us = 100, .max_interval_us = 5000,  .budget = 0   },
+        { .min_interval_us = 100, .max_interval_us = 20000, .budget = 0   },
+        { .min_interval_us = 100, .max_interval_us = 5000,  .budget = 32  },
+    };
+    const char *names[] = {
+        "fixed spin",
+        "fixed 100us",
+        "adaptive 100us-5ms",
+        "adaptive 100us-20ms",
+        "adaptive 100us-5ms/32",
+    };
+    unsigned long reads;
+    unsigned long base_reads = 0;
+    double        error;
+
+    if ((argc == 3) && (strcmp(argv[1], EXEC_ARG) == 0))
+        exec_child(atoi(argv[2]));
+
+    printf("%d children, %d us idle, %d x %d KiB burst, %d us hold\n",
+        NUM_CHILDREN, 2 * IDLE_US, BURST_STEPS, STEP_BYTES / 1024, HOLD_US);
+    printf("%-24s %12s %14s %12s\n", "sampler", "reads", "reads/child", "peak error");
+
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+    {
+        run(&configs[i], &reads, &error);
+        if (i == 0)
+            base_reads = reads;
+
+        printf("%-24s %12lu %14.0f %11.2f%% (%.1fx fewer reads)\n",
+            names[i], reads, (double) reads / NUM_CHILDREN, 100 * error, (double) base_reads / reads);
+    }
+
+    run_exec();
+    return 0;
+}
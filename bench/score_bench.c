@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../include/score_pipeline.h"
+#include "../include/classifier.h"
+#include "../include/stats_util.h"
+#include "../include/rand_util.h"
+
+//=============================================================================
+// CONSTANTS:
+//=============================================================================
+#define NUM_SAMPLES     (16 * 1024)
+#define NUM_ROUNDS      2048
+#define TRAIN_SAMPLES   250
+#define MU_1            100
+#define SIGMA_1         10
+#define MU_2            160
+#define SIGMA_2         10
+#define BASE_PAGES      50
+#define EWMA_ALPHA      0.01
+#define HIST_BINS       64
+
+//=============================================================================
+// SPECIALIZED PIPELINES:
+//=============================================================================
+DEFINE_SCORE_PIPELINE(zscore_counts, struct statm_t, data, zscore, counts)
+DEFINE_SCORE_PIPELINE(mahalanobis_counts, struct statm_t, data, mahalanobis, counts)
+DEFINE_SCORE_PIPELINE(ewma_counts, struct statm_t, data, ewma, counts)
+DEFINE_SCORE_PIPELINE(zscore_histogram, struct statm_t, data, zscore, histogram)
+
+//=============================================================================
+// HELPERS:
+//=============================================================================
+static double now_s(void)
+{
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return tp.tv_sec + tp.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, double seconds, double base_seconds, struct stats_t *stats)
+{
+    printf("%-28s %10.2f ns/sample %8.2fx", name,
+        seconds * 1e9 / ((double) NUM_SAMPLES * NUM_ROUNDS), base_seconds / seconds);
+    if (stats != NULL)
+        printf("   accuracy %0.6f", stats->get_accuracy(stats));
+    printf("\n");
+}
+
+//=============================================================================
+// MAIN:
+//=============================================================================
+int main(void)
+{
+    struct statm_t              *samples;
+    int                         *actual;
+    struct gaussian_occ_t       *classifier;
+    struct stats_t              *stats;
+    struct rng_t                 rng;
+    struct zscore_scorer_t       zscore;
+    struct mahalanobis_scorer_t  mahalanobis;
+    struct ewma_scorer_t         ewma;
+    struct counts_sink_t         counts;
+    struct histogram_sink_t      histogram;
+    unsigned long                bins[2 * HIST_BINS];
+    double                       train[TRAIN_SAMPLES];
+    double                       mean;
+    double                       stddev;
+    double                       start;
+    double                       base;
+    double                       elapsed;
+
+    samples    = (struct statm_t *) calloc(NUM_SAMPLES, sizeof(struct statm_t));
+    actual     = (int *) malloc(NUM_SAMPLES * sizeof(int));
+    classifier = create_classifier();
+
+    if ((samples == NULL) || (actual == NULL) || (classifier == NULL))
+    {
+        printf("Error: unable to allocate enough memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    //-------------------------------------------------------------------------
+    // Random statm samples from two workloads, interleaved at random so that
+    // predictions can't be guessed by the branch predictor. The samples fit
+    // in cache so that the loop, not memory bandwidth, is measured.
+    //-------------------------------------------------------------------------
+    seed_rng(&rng, 1);
+    for (int i = 0; i < TRAIN_SAMPLES; i++)
+        train[i] = norm_rand_r(&rng, MU_1, SIGMA_1);
+
+    for (int i = 0; i < NUM_SAMPLES; i++)
+    {
+        actual[i] = uniform_rand_r(&rng) < 0.5;
+        samples[i].data = BASE_PAGES + (unsigned long) (actual[i]
+            ? norm_rand_r(&rng, MU_1, SIGMA_1)
+            : norm_rand_r(&rng, MU_2, SIGMA_2));
+    }
+
+    classifier->train(classifier, train, TRAIN_SAMPLES);
+    gaussian_occ_get_params(classifier, &mean, &stddev);
+
+    printf("%d samples x %d rounds\n", NUM_SAMPLES, NUM_ROUNDS);
+
+    //-------------------------------------------------------------------------
+    // Function pointer dispatch through classify and add_stat.
+    //-------------------------------------------------------------------------
+    stats = create_stats();
+    start = now_s();
+    for (int r = 0; r < NUM_ROUNDS; r++)
+    {
+        for (int i = 0; i < NUM_SAMPLES; i++)
+            stats->add_stat(stats, actual[i],
+                classifier->classify(classifier, (double) samples[i].data - BASE_PAGES));
+    }
+    base = now_s() - start;
+    report("dynamic classify+add_stat", base, base, stats);
+    delete_stats(stats);
+
+    //-------------------------------------------------------------------------
+    // Specialized pipelines.
+    //-------------------------------------------------------------------------
+    stats = create_stats();
+    init_zscore_scorer(&zscore, mean, stddev, GAUSSIAN_OCC_Z_THRESH);
+    init_counts_sink(&counts);
+    start = now_s();
+    for (int r = 0; r < NUM_ROUNDS; r++)
+        zscore_counts(samples, actual, NUM_SAMPLES, BASE_PAGES, &zscore, &counts);
+    flush_counts_sink(&counts, stats);
+    elapsed = now_s() - start;
+    report("static zscore+counts", elapsed, base, stats);
+    delete_stats(stats);
+
+    stats = create_stats();
+    init_mahalanobis_scorer(&mahalanobis, mean, stddev, GAUSSIAN_OCC_Z_THRESH);
+    start = now_s();
+    for (int r = 0; r < NUM_ROUNDS; r++)
+        mahalanobis_counts(samples, actual, NUM_SAMPLES, BASE_PAGES, &mahalanobis, &counts);
+    flush_counts_sink(&counts, stats);
+    elapsed = now_s() - start;
+    report("static mahalanobis+counts", elapsed, base, stats);
+    delete_stats(stats);
+
+    stats = create_stats();
+    init_ewma_scorer(&ewma, mean, stddev, GAUSSIAN_OCC_Z_THRESH, EWMA_ALPHA);
+    start = now_s();
+    for (int r = 0; r < NUM_ROUNDS; r++)
+        ewma_counts(samples, actual, NUM_SAMPLES, BASE_PAGES, &ewma, &counts);
+    flush_counts_sink(&counts, stats);
+    elapsed = now_s() - start;
+    report("static ewma+counts", elapsed, base, stats);
+    delete_stats(stats);
+
+    init_histogram_sink(&histogram, mean - 5 * stddev, 10 * stddev / HIST_BINS, HIST_BINS, bins);
+    start = now_s();
+    for (int r = 0; r < NUM_ROUNDS; r++)
+        zscore_histogram(samples, NULL, NUM_SAMPLES, BASE_PAGES, &zscore, &histogram);
+    elapsed = now_s() - start;
+    report("static zscore+histogram", elapsed, base, NULL);
+
+    delete_classifier(classifier);
+    free(actual);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/**
+ * Default size in bytes of the chunks an arena requests from malloc.
+ */
+#define ARENA_DEFAULT_CHUNK_SIZE (1 << 20)
+
+/**
+ * Alignment in bytes of every block handed out by an arena.
+ */
+#define ARENA_ALIGNMENT (16)
+
+/**
+ * Private data used by the arena. Forward declared here so it can
+ * be used in the arena struct, but the implementation is private.
+ */
+struct arena_data_t;
+
+/**
+ * Region based allocator. Memory is carved out of large chunks obtained from
+ * malloc and is never freed individually. Everything allocated from an arena
+ * is released at once by resetting or deleting the arena.
+ */
+struct arena_t
+{
+    /**
+     * Private data used by the arena.
+     */
+    struct arena_data_t *data;
+
+    /**
+     * Allocate a block of memory from the arena.
+     *
+     * @param self the arena object.
+     * @param size number of bytes to allocate.
+     * @return pointer to the block, or NULL if out of memory.
+     */
+    void *(*alloc)(struct arena_t *self, size_t size);
+
+    /**
+     * Resize a block previously returned by alloc. If the block is the most
+     * recent allocation and the current chunk has room, it is grown in place.
+     * Otherwise a new block is allocated and the contents are copied over.
+     *
+     * @param self the arena object.
+     * @param ptr the block to resize, or NULL to allocate a new block.
+     * @param old_size current size of the block in bytes.
+     * @param new_size requested size of the block in bytes.
+     * @return pointer to the resized block, or NULL if out of memory.
+     */
+    void *(*realloc)(struct arena_t *self, void *ptr, size_t old_size, size_t new_size);
+
+    /**
+     * Release every allocation made from the arena at once. The chunks are
+     * kept and reused by subsequent allocations.
+     */
+    void (*reset)(struct arena_t *self);
+
+    /**
+     * Number of times the arena has called malloc since it was created.
+     */
+    size_t (*num_mallocs)(struct arena_t *self);
+};
+
+/**
+ * Growable array of samples backed by an arena.
+ */
+struct sample_buf_t
+{
+    double         *samples; // contiguous sample storage
+    size_t          len;     // number of samples stored
+    size_t          cap;     // number of samples that fit before growing
+    struct arena_t *arena;   // arena the storage is allocated from
+};
+
+/**
+ * Create a new arena object.
+ *
+ * @param chunk_size number of bytes to request from malloc at a time.
+ */
+struct arena_t *create_arena(size_t chunk_size);
+
+/**
+ * Free up all the chunks owned by the arena and the arena object itself.
+ */
+void delete_arena(struct arena_t *arena);
+
+/**
+ * Initialize a sample buffer with room for cap samples.
+ *
+ * @param buf the sample buffer to initialize.
+ * @param arena the arena to allocate the storage from.
+ * @param cap initial number of samples the buffer can hold.
+ * @return On success, returns 0. On error, returns -1.
+ */
+int init_sample_buf(struct sample_buf_t *buf, struct arena_t *arena, size_t cap);
+
+/**
+ * Append a sample to the buffer, doubling its capacity when it is full.
+ *
+ * @param buf the sample buffer.
+ * @param sample the sample to append.
+ * @return On success, returns 0. On error, returns -1.
+ */
+int sample_buf_push(struct sample_buf_t *buf, double sample);
+
+#endif
@@ -3,12 +3,23 @@
 
 #include <stddef.h>
 
+/**
+ * Samples with a z-score above this threshold are classified as outside
+ * the class the classifier has been trained on.
+ */
+#define GAUSSIAN_OCC_Z_THRESH (3)
+
 /**
  * Private data used by the classifier. Forward declared here so it can
  * be used in the classifier struct, but the implementation is private.
  */
 struct gaussian_occ_data_t;
 
+/**
+ * Arena the classifier can be allocated from. See arena.h.
+ */
+struct arena_t;
+
 /**
  * Gaussian one class classifier
  */
@@ -39,14 +50,62 @@ struct gaussian_occ_t
     int (*classify)(struct gaussian_occ_t *self, double sample);
 };
 
+/**
+ * Fits a gaussian to a set of samples. This is the training step shared by
+ * the classifier and by anything else that stores gaussian parameters.
+ *
+ * @param samples the data points to fit.
+ * @param num_samples number of data points in the samples array.
+ * @param mean on return, the sample mean.
+ * @param stddev on return, the sample standard deviation.
+ */
+void gaussian_occ_fit(const double samples[], size_t num_samples, double *mean, double *stddev);
+
+/**
+ * Get the parameters of a trained classifier, e.g. to score samples with a
+ * specialized pipeline instead of calling classify (see score_pipeline.h).
+ *
+ * @param classifier the trained classifier object.
+ * @param mean on return, the mean of the class.
+ * @param stddev on return, the standard deviation of the class.
+ */
+void gaussian_occ_get_params(const struct gaussian_occ_t *classifier, double *mean, double *stddev);
+
 /**
  * Create a new gaussian one class classifier object.
  */
 struct gaussian_occ_t *create_classifier(void);
 
+/**
+ * Create a new gaussian one class classifier object inside an arena. The
+ * object is released together with the arena and must not be passed to
+ * delete_classifier.
+ */
+struct gaussian_occ_t *create_classifier_in(struct arena_t *arena);
+
 /**
  * Free up the resources allocated for a gaussian one class classifier object.
  */
 void delete_classifier(struct gaussian_occ_t *classifier);
 
+/**
+ * Save the parameters of a trained classifier to a snapshot file. The file
+ * is replaced atomically. See snapshot.h.
+ *
+ * @param classifier the trained classifier object.
+ * @param path where to install the snapshot.
+ * @return On success, returns 0. On error, returns -1.
+ */
+int save_classifier(struct gaussian_occ_t *classifier, const char *path);
+
+/**
+ * Load the parameters of a classifier from a snapshot file, so it can
+ * classify samples without being trained first.
+ *
+ * @param classifier the classifier object to load the parameters into.
+ * @param path the snapshot file.
+ * @return On success, returns 0. On error, returns -1.
+ */
+int load_classifier(struct gaussian_occ_t *classifier, const char *path);
+
 #endif
\ No newline at end of file
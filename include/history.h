@@ -0,0 +1,153 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * Number of records compressed together into one block. A block is the unit
+ * that is written, indexed and decoded.
+ */
+#define HISTORY_BLOCK_RECORDS (4096)
+
+/**
+ * Size after which a segment file is closed and a new one is started. Old
+ * segments can be deleted (or archived) as whole files to drop old history.
+ */
+#define HISTORY_SEGMENT_BYTES (64 * 1024 * 1024)
+
+/**
+ * Workload id that matches every workload in queries.
+ */
+#define HISTORY_ALL_WORKLOADS (0)
+
+/**
+ * A single measured process.
+ */
+struct history_record_t
+{
+    int64_t  timestamp;  // wall clock time of the measurement in milliseconds
+    int32_t  pid;        // process id
+    uint32_t workload;   // workload id, see history_workload_id
+    uint64_t peak;       // peak memory usage in pages
+    int      prediction; // classifier prediction, 1 = within class, 0 = anomaly
+    int      training;   // set if the peak trained its workload's model instead of being classified
+};
+
+/**
+ * Called by query for every matching record. Returning non-zero stops the
+ * query.
+ */
+typedef int (*history_visit_t)(const struct history_record_t *record, void *arg);
+
+/**
+ * Private data used by the history store. Forward declared here so it can
+ * be used in the history struct, but the implementation is private.
+ */
+struct history_data_t;
+
+/**
+ * Append-only store of measured processes kept in a directory of segment
+ * files. Records are buffered and compressed HISTORY_BLOCK_RECORDS at a
+ * time: timestamps as zigzag varint deltas of deltas, pids and peaks as
+ * zigzag varint deltas, and workloads as indices into a per-block table. A
+ * typical record takes a few bytes instead of a text line.
+ *
+ * Every block header carries the block's time range and a bloom filter of
+ * its workloads. The headers form a sparse index that is read on open, so
+ * queries only decode the blocks that can hold matching records.
+ *
+ * A history store is not thread safe.
+ */
+struct history_t
+{
+    /**
+     * Private data used by the history store.
+     */
+    struct history_data_t *data;
+
+    /**
+     * Add a record. Records are written out once a block is full, on flush
+     * and on close, and are visible to query right away.
+     *
+     * @param self the history object.
+     * @param record the record to add.
+     * @return On success, returns 0. On error, returns -1.
+     */
+    int (*append)(struct history_t *self, const struct history_record_t *record);
+
+    /**
+     * Write out the buffered records as a (possibly partial) block and sync
+     * the segment file to disk.
+     *
+     * @param self the history object.
+     * @return On success, returns 0. On error, returns -1.
+     */
+    int (*flush)(struct history_t *self);
+
+    /**
+     * Visit the records with from <= timestamp < to of a workload, in the
+     * order they were appended.
+     *
+     * @param self the history object.
+     * @param from start of the time range in milliseconds.
+     * @param to end of the time range in milliseconds.
+     * @param workload workload id to match, or HISTORY_ALL_WORKLOADS.
+     * @param visit called for every matching record.
+     * @param arg passed to visit.
+     * @return the number of records visited, or -1 on error.
+     */
+    long (*query)(struct history_t *self, int64_t from, int64_t to, uint32_t workload,
+        history_visit_t visit, void *arg);
+};
+
+/**
+ * Open a history store, creating its directory if needed. The block headers
+ * of every segment are read to build the index. A block torn by a crash at
+ * the end of the last segment is cut off so that appending can continue.
+ *
+ * @param dir directory holding the segment files.
+ * @return On success, returns a pointer to a history object. On error, returns NULL.
+ */
+struct history_t *open_history(const char *dir);
+
+/**
+ * Flush and close a history store and free its memory.
+ */
+void close_history(struct history_t *history);
+
+/**
+ * Returns the current wall clock time in milliseconds, as stored in records.
+ */
+int64_t history_now(void);
+
+/**
+ * Map a workload identifier (e.g. a command name) to the id stored in
+ * records. Equal keys always map to the same id, which is never
+ * HISTORY_ALL_WORKLOADS.
+ */
+uint32_t history_workload_id(const char *key);
+
+/**
+ * Training samples read back from the history store. See arena.h.
+ */
+struct sample_buf_t;
+
+/**
+ * Collect the peaks of the records of a workload in a time range that
+ * trained a model, e.g. to train a classifier again without measuring.
+ * Records that were only classified are skipped, even within class, since
+ * the model that classified them may have been wrong.
+ *
+ * @param history the history object.
+ * @param from start of the time range in milliseconds.
+ * @param to end of the time range in milliseconds.
+ * @param workload workload id to match, or HISTORY_ALL_WORKLOADS.
+ * @param samples initialized sample buffer the peaks are appended to.
+ * @return the number of peaks appended, or -1 on error.
+ */
+long history_load_samples(struct history_t *history, int64_t from, int64_t to, uint32_t workload,
+    struct sample_buf_t *samples);
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef MEM_SAMPLER_H
+#define MEM_SAMPLER_H
+
+#include <sys/types.h>
+#include "mem_util.h"
+
+/**
+ * Samples the memory usage of a single process in two tiers. The cheap
+ * /proc/[pid]/statm is read on every sample. The expensive
+ * /proc/[pid]/smaps_rollup is only read when the process' resident set is
+ * at least rollup_thresh pages and larger than it was at the previous
+ * smaps_rollup read, i.e. when a large process may have reached a new peak.
+ *
+ * A rollup_thresh of 0 reads smaps_rollup on every new resident peak and
+ * MEM_SAMPLER_NO_ROLLUP never reads it.
+ */
+struct mem_sampler_t
+{
+    int           statm_fd;        // open /proc/[pid]/statm file descriptor
+    int           rollup_fd;       // open /proc/[pid]/smaps_rollup file descriptor, negative if not open
+    unsigned long rollup_thresh;   // resident pages from which smaps_rollup is read
+    unsigned long rollup_resident; // resident pages at the previous smaps_rollup read
+};
+
+/**
+ * Threshold that disables the smaps_rollup tier.
+ */
+#define MEM_SAMPLER_NO_ROLLUP ((unsigned long) -1)
+
+/**
+ * A single sample taken by mem_sampler_read.
+ */
+struct mem_sample_t
+{
+    struct statm_t        statm;      // always valid
+    struct smaps_rollup_t rollup;     // only valid if has_rollup is set
+    int                   has_rollup; // whether smaps_rollup was read for this sample
+};
+
+/**
+ * Opens the files of process pid that a sampler reads. smaps_rollup is
+ * opened lazily on the first sample that needs it; if it cannot be opened
+ * (old kernel, no permission) the sampler silently stays on statm.
+ *
+ * @param sampler the sampler to initialize.
+ * @param pid process to sample.
+ * @param rollup_thresh resident pages from which smaps_rollup is read.
+ * @return On success, returns 0. On error (e.g. the process is gone), returns -1.
+ */
+int open_mem_sampler(struct mem_sampler_t *sampler, pid_t pid, unsigned long rollup_thresh);
+
+/**
+ * Takes one sample. This does not allocate any memory.
+ *
+ * @param sampler a sampler initialized by open_mem_sampler.
+ * @param pid the process passed to open_mem_sampler.
+ * @param sample on success, holds the sample.
+ * @return On success, returns 0. Otherwise (e.g. once the process has been
+ * reaped), returns -1.
+ */
+int mem_sampler_read(struct mem_sampler_t *sampler, pid_t pid, struct mem_sample_t *sample);
+
+/**
+ * Forgets the smaps_rollup state of a sampler after its process called
+ * exec. An open smaps_rollup file stays bound to the address space the
+ * process had when it was opened, so it is closed and reopened by the next
+ * sample that needs it. statm always reads the current address space and is
+ * kept open.
+ *
+ * @param sampler a sampler initialized by open_mem_sampler.
+ */
+void reset_mem_sampler_rollup(struct mem_sampler_t *sampler);
+
+/**
+ * Closes the files opened by a sampler.
+ */
+void close_mem_sampler(struct mem_sampler_t *sampler);
+
+/**
+ * Settings for adaptive sampling rates.
+ */
+struct sample_rate_config_t
+{
+    long          min_interval_us; // interval used while memory usage is changing
+    long          max_interval_us; // longest interval backed off to while it is flat
+    unsigned long budget;          // most samples taken per process, 0 for no limit
+};
+
+/**
+ * Adaptive sampling rate of a single process. Every sample that differs from
+ * the previous one drops the interval back to min_interval_us, since a
+ * process whose memory is moving may be heading for a peak. Every sample
+ * equal to the previous one doubles it, up to max_interval_us, so idle
+ * processes cost few reads.
+ */
+struct sample_rate_t
+{
+    const struct sample_rate_config_t *config;
+    long                               interval_us; // time until the next sample
+    unsigned long                      samples;     // samples taken so far
+    unsigned long                      last;        // value of the previous sample
+};
+
+/**
+ * Initializes the sampling rate of a new process at min_interval_us.
+ */
+void init_sample_rate(struct sample_rate_t *rate, const struct sample_rate_config_t *config);
+
+/**
+ * Records a sample and computes how long to wait before the next one.
+ *
+ * @param rate the sampling rate of the process.
+ * @param value the sampled value, e.g. statm data pages.
+ * @return the time to wait before the next sample in microseconds, or -1 once
+ * the process' budget is used up and it should not be sampled again.
+ */
+long next_sample_interval(struct sample_rate_t *rate, unsigned long value);
+
+#endif
@@ -44,4 +44,60 @@ struct statm_t {
  */
 int parse_statm(pid_t pid, struct statm_t *statm);
 
+/**
+ * Opens /proc/[pid]/statm so that it can be sampled repeatedly with
+ * read_statm without paying for path lookup and stdio on every sample.
+ *
+ * @param pid process whose memory usage will be sampled.
+ * @return On success, returns a file descriptor. Otherwise, returns -1.
+ */
+int open_statm(pid_t pid);
+
+/**
+ * Reads and parses /proc/[pid]/statm through a file descriptor returned by
+ * open_statm. This does not allocate any memory.
+ *
+ * @param fd file descriptor returned by open_statm.
+ * @param statm on success, will be updated with the current memory usage of the process.
+ * @return If the file is parsed successfully, return 0. Otherwise (e.g. once the
+ * process has been reaped), returns -1.
+ */
+int read_statm(int fd, struct statm_t *statm);
+
+/**
+ * Subset of the fields of /proc/[pid]/smaps_rollup, measured in kilobytes.
+ * Unlike statm, these count only memory that is actually resident (or
+ * swapped out), and PSS divides shared pages between the processes mapping
+ * them. See `man proc` for more details.
+ */
+struct smaps_rollup_t {
+    unsigned long rss;       // resident set size
+    unsigned long pss;       // proportional set size
+    unsigned long anonymous; // resident anonymous memory
+    unsigned long swap;      // anonymous memory swapped out
+};
+
+/**
+ * Opens /proc/[pid]/smaps_rollup so that it can be sampled repeatedly with
+ * read_smaps_rollup. Requires Linux 4.14 and permission to ptrace the process.
+ *
+ * @param pid process whose memory usage will be sampled.
+ * @return On success, returns a file descriptor. Otherwise, returns -1.
+ */
+int open_smaps_rollup(pid_t pid);
+
+/**
+ * Reads and parses /proc/[pid]/smaps_rollup through a file descriptor
+ * returned by open_smaps_rollup. This does not allocate any memory.
+ *
+ * Reading smaps_rollup walks every mapping of the process, so it costs much
+ * more than read_statm and should only be used when the extra accuracy is
+ * needed.
+ *
+ * @param fd file descriptor returned by open_smaps_rollup.
+ * @param rollup on success, will be updated with the current memory usage of the process.
+ * @return If the file is parsed successfully, return 0. Otherwise, returns -1.
+ */
+int read_smaps_rollup(int fd, struct smaps_rollup_t *rollup);
+
 #endif
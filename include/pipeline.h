@@ -0,0 +1,157 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "mem_sampler.h"
+
+/**
+ * Registry of per-workload classifiers. See registry.h.
+ */
+struct registry_t;
+
+/**
+ * Store scored processes are recorded in. See history.h.
+ */
+struct history_t;
+
+/**
+ * Private data used by the pipeline. Forward declared here so it can
+ * be used in the pipeline struct, but the implementation is private.
+ */
+struct pipeline_data_t;
+
+/**
+ * Settings for a monitoring pipeline.
+ */
+struct pipeline_config_t
+{
+    size_t                      num_samplers;        // number of sampler threads
+    size_t                      max_tracked;         // maximum number of processes tracked at once
+    size_t                      max_workloads;       // capacity of the registry passed to create_pipeline
+    size_t                      queue_size;          // capacity of each queue between stages
+    size_t                      chunk_size;          // table buckets a sampler claims at a time
+    size_t                      train_samples;       // exited processes to collect before training an untrained workload, 0 to never train
+    struct sample_rate_config_t sample_rate;         // adaptive sampling rate of every process, see mem_sampler.h
+    unsigned long               rollup_thresh_pages; // resident pages from which smaps_rollup is read, see mem_sampler.h
+    struct history_t           *history;             // where exited processes are recorded, or NULL
+};
+
+/**
+ * Counters describing the work done by a pipeline.
+ */
+struct pipeline_stats_t
+{
+    unsigned long submitted;    // processes accepted by submit
+    unsigned long rejected;     // processes refused because the pipeline was full
+    unsigned long rounds;       // sampling rounds completed
+    unsigned long reads;        // reads of /proc/[pid]/statm
+    unsigned long rollup_reads; // reads of /proc/[pid]/smaps_rollup
+    unsigned long steals;       // chunks sampled by a thread other than their owner
+    unsigned long exits;        // processes found to have exited
+    unsigned long stalls;       // times a stage waited on a full queue
+    unsigned long trained;      // exited processes used to train their workload
+    unsigned long scored;       // exited processes classified
+    unsigned long anomalies;    // exited processes classified as outside their workload's class
+    unsigned long tracked;      // processes tracked right now
+    unsigned long max_tracked;  // most processes tracked at once
+};
+
+/**
+ * Multithreaded monitoring pipeline. The stages are connected by lock-free
+ * queues:
+ *
+ *  submit/exec/finish -> [sampler inboxes] -> samplers -> [exit queue]
+ *         -> classifier -> [result queue] -> writer
+ *
+ * Discovery:  the caller (e.g. a proc connector listener) reports process
+ *             events. submit opens the /proc/[pid] files of a new process
+ *             and takes its first sample; every event is then queued to the
+ *             sampler that owns the pid.
+ * Samplers:   a pool of threads that run a round every min_interval_us of
+ *             sample_rate and sample every tracked process that is due. Each
+ *             process is sampled at its own adaptive rate, so one whose
+ *             memory is flat is read less and less often, and one that has
+ *             used up its budget is no longer read and waits for finish.
+ *             Each thread owns the processes whose pid maps to it, applies
+ *             their events between rounds, and claims them in chunks while
+ *             sampling; a thread that runs out of work steals chunks from the
+ *             other partitions. A process that has exited,
+ *             either reported by finish or found because its statm can no
+ *             longer be read, is queued for classification.
+ * Classifier: scores exited processes in batches with the registry model of
+ *             their workload. Workloads without a model are trained online
+ *             from their first train_samples exited processes instead.
+ * Writer:     the only stage that produces output. It records every exited
+ *             process in the history store and writes anomalies as
+ *             "pid workload peak_pages peak_pss_kb" lines, with a peak PSS of
+ *             0 if smaps_rollup was never read.
+ */
+struct pipeline_t
+{
+    /**
+     * Private data used by the pipeline.
+     */
+    struct pipeline_data_t *data;
+
+    /**
+     * Start monitoring a new process. The events of a process must be
+     * reported from a single thread.
+     *
+     * @param self the pipeline object.
+     * @param pid the process to monitor.
+     * @param slot the registry slot of the process' workload, or -1 if it has none.
+     * @return On success, returns 0. If the process can't be tracked, returns -1.
+     */
+    int (*submit)(struct pipeline_t *self, pid_t pid, int slot);
+
+    /**
+     * Report that a monitored process replaced its program. Its peak starts
+     * from scratch under its new workload.
+     *
+     * @param self the pipeline object.
+     * @param pid the process.
+     * @param slot the registry slot of the process' new workload, or -1 if it has none.
+     */
+    void (*exec)(struct pipeline_t *self, pid_t pid, int slot);
+
+    /**
+     * Report that a monitored process has exited, so it is classified without
+     * waiting for its /proc files to disappear.
+     *
+     * @param self the pipeline object.
+     * @param pid the process.
+     */
+    void (*finish)(struct pipeline_t *self, pid_t pid);
+
+    /**
+     * Get a snapshot of the pipeline counters.
+     */
+    void (*get_stats)(struct pipeline_t *self, struct pipeline_stats_t *stats);
+
+    /**
+     * Stop the pipeline and wait for the processes already found to have
+     * exited to be classified and written. No events may be reported
+     * afterwards, but the counters can still be read.
+     */
+    void (*stop)(struct pipeline_t *self);
+};
+
+/**
+ * Create a new pipeline object and start its threads.
+ *
+ * @param registry the registry used to classify exited processes.
+ * @param config settings for the pipeline.
+ * @param out where the writer stage writes anomalies, or NULL to discard them.
+ * @return the pipeline, or NULL if memory could not be allocated or a thread
+ *         could not be started.
+ */
+struct pipeline_t *create_pipeline(struct registry_t *registry, const struct pipeline_config_t *config, FILE *out);
+
+/**
+ * Stop the pipeline if it is still running and free up its resources.
+ */
+void delete_pipeline(struct pipeline_t *pipeline);
+
+#endif
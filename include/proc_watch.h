@@ -0,0 +1,92 @@
+#ifndef PROC_WATCH_H
+#define PROC_WATCH_H
+
+#include <stddef.h>
+#include "mem_sampler.h"
+
+/**
+ * Registry of per-workload classifiers. See registry.h.
+ */
+struct registry_t;
+
+/**
+ * Store scored processes are recorded in. See history.h.
+ */
+struct history_t;
+
+/**
+ * Settings for watch mode.
+ */
+struct watch_config_t
+{
+    size_t                      num_samplers;        // number of sampler threads
+    size_t                      max_tracked;         // maximum number of processes tracked at once
+    size_t                      max_workloads;       // capacity of the registry passed to run_watch
+    size_t                      train_samples;       // exited processes to collect before training an untrained workload
+    struct sample_rate_config_t sample_rate;         // adaptive sampling rate of every tracked process
+    int                         report_interval_ms;  // time between backpressure reports on stderr
+    int                         rcvbuf_bytes;        // size of the netlink socket receive buffer
+    unsigned long               rollup_thresh_pages; // resident pages from which smaps_rollup is read, see mem_sampler.h
+    struct history_t           *history;             // where exited processes are recorded, or NULL
+    const char                 *snapshot_path;       // registry snapshot reloaded whenever it is replaced, or NULL
+};
+
+/**
+ * Counters describing the work done by watch mode and how well it is
+ * keeping up with the kernel.
+ */
+struct watch_stats_t
+{
+    unsigned long events;       // proc connector events received
+    unsigned long forks;        // new processes seen
+    unsigned long execs;        // processes that changed program
+    unsigned long exits;        // processes that exited
+    unsigned long overruns;     // times the socket buffer overflowed and events were lost
+    unsigned long rejected;     // new processes not tracked because the pipeline was full
+    unsigned long reads;        // reads of /proc/[pid]/statm
+    unsigned long rollup_reads; // reads of /proc/[pid]/smaps_rollup
+    unsigned long steals;       // chunks of processes sampled by a thread other than their owner
+    unsigned long stalls;       // times a pipeline stage waited on a full queue
+    unsigned long trained;      // exited processes used to train their workload
+    unsigned long scored;       // exited processes classified
+    unsigned long anomalies;    // exited processes classified as outside their workload's class
+    unsigned long tracked;      // processes tracked right now
+    unsigned long max_tracked;  // most processes tracked at once
+};
+
+/**
+ * Watch every process on the host using the kernel proc connector. The
+ * calling thread only receives process events and feeds them to a pipeline
+ * (see pipeline.h) of num_samplers sampler threads, a classifier thread and
+ * a writer thread. New processes are tracked through a persistent
+ * /proc/[pid]/statm file descriptor and sampled at an adaptive rate: every
+ * sample_rate.min_interval_us while their memory usage is changing, backing
+ * off to max_interval_us while it is flat, and at most budget times.
+ * Processes whose resident set reaches rollup_thresh_pages are additionally
+ * sampled through smaps_rollup at every new resident peak to record their
+ * peak PSS. When a process exits, its peak memory usage is classified by the
+ * registry model of its workload, which is the process' command name.
+ * Workloads without a trained model are trained online from the first
+ * train_samples processes that exit. Anomalies are written to stdout by the
+ * writer thread as "pid workload peak_pages peak_pss_kb", with a peak PSS of
+ * 0 if smaps_rollup was never read, and backpressure metrics to stderr. If
+ * config->history is set, every exited process that is classified or used
+ * for training is recorded in it. If config->snapshot_path is set, the
+ * registry is reloaded from it at every report interval in which a new
+ * snapshot has been installed there.
+ *
+ * Runs until SIGINT or SIGTERM is received. Requires CAP_NET_ADMIN.
+ *
+ * @param registry the registry of per-workload classifiers.
+ * @param config settings for watch mode.
+ * @param stats on return, the counters accumulated while watching.
+ * @return On success, returns 0. On error, returns -1.
+ */
+int run_watch(struct registry_t *registry, const struct watch_config_t *config, struct watch_stats_t *stats);
+
+/**
+ * Print watch mode counters to stderr.
+ */
+void print_watch_stats(const struct watch_stats_t *stats);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stddef.h>
+
+/**
+ * Private data used by the queue. Forward declared here so it can
+ * be used in the queue struct, but the implementation is private.
+ */
+struct queue_data_t;
+
+/**
+ * Bounded lock-free queue of fixed size items. Any number of threads may
+ * push and pop concurrently. Items are copied in and out of the queue.
+ */
+struct queue_t
+{
+    /**
+     * Private data used by the queue.
+     */
+    struct queue_data_t *data;
+
+    /**
+     * Copy an item to the back of the queue.
+     *
+     * @param self the queue object.
+     * @param item the item to push, item_size bytes long.
+     * @return On success, returns 0. If the queue is full, returns -1.
+     */
+    int (*push)(struct queue_t *self, const void *item);
+
+    /**
+     * Copy the item at the front of the queue out and remove it.
+     *
+     * @param self the queue object.
+     * @param item on success, will hold the item, item_size bytes long.
+     * @return On success, returns 0. If the queue is empty, returns -1.
+     */
+    int (*pop)(struct queue_t *self, void *item);
+};
+
+/**
+ * Create a new queue object.
+ *
+ * @param capacity maximum number of items in the queue, rounded up to a power of 2.
+ * @param item_size size of each item in bytes.
+ */
+struct queue_t *create_queue(size_t capacity, size_t item_size);
+
+/**
+ * Free up the resources allocated for a queue object.
+ */
+void delete_queue(struct queue_t *queue);
+
+#endif
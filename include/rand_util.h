@@ -1,6 +1,18 @@
 #ifndef RAND_UTIL_H
 #define RAND_UTIL_H
 
+#include <stdint.h>
+
+/**
+ * State of a seeded pseudo random number generator (xoshiro256**). Unlike
+ * norm_rand, which reseeds from the clock on every call, a generator seeded
+ * with seed_rng produces the same sequence every run.
+ */
+struct rng_t
+{
+    uint64_t s[4];
+};
+
 /**
  * Generates a random number from the normal distribution with mean mu and
  * standard deviation sigma.
@@ -10,4 +22,29 @@
  */
 double norm_rand(double mu, double sigma);
 
+/**
+ * Seeds a pseudo random number generator.
+ *
+ * @param rng the generator to seed.
+ * @param seed any value; equal seeds give equal sequences.
+ */
+void seed_rng(struct rng_t *rng, uint64_t seed);
+
+/**
+ * Generates a random number uniformly distributed in [0, 1).
+ *
+ * @param rng the generator to draw from.
+ */
+double uniform_rand_r(struct rng_t *rng);
+
+/**
+ * Generates a random number from the normal distribution with mean mu and
+ * standard deviation sigma, drawing from a seeded generator.
+ *
+ * @param rng the generator to draw from.
+ * @param mu the mean of the normal distribution to be sampled.
+ * @param sigma the standard deviation of the normal distribution to be sampled
+ */
+double norm_rand_r(struct rng_t *rng, double mu, double sigma);
+
 #endif
@@ -0,0 +1,165 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stddef.h>
+
+/**
+ * Maximum length of a workload identifier, including the terminating null
+ * byte. Longer identifiers (e.g. deep cgroup paths) are truncated.
+ */
+#define REGISTRY_KEY_LEN (64)
+
+/**
+ * Private data used by the registry. Forward declared here so it can
+ * be used in the registry struct, but the implementation is private.
+ */
+struct registry_data_t;
+
+/**
+ * Registry of gaussian one class classifiers, one per workload. Workloads are
+ * identified by a string key such as a command name or a cgroup path, and are
+ * assigned a fixed slot when added. The classifier parameters of all slots are
+ * stored column-wise so a sweep over many processes is a single pass over
+ * flat arrays.
+ *
+ * Reads (lookup, classify, classify_batch, get_params) never take a lock and
+ * can run concurrently with add and train, which are serialized internally.
+ */
+struct registry_t
+{
+    /**
+     * Private data used by the registry.
+     */
+    struct registry_data_t *data;
+
+    /**
+     * Find the slot of a workload.
+     *
+     * @param self the registry object.
+     * @param key the workload identifier.
+     * @return the slot of the workload, or -1 if it has not been added.
+     */
+    int (*lookup)(struct registry_t *self, const char *key);
+
+    /**
+     * Add a workload to the registry. Adding a workload that already exists
+     * returns its current slot. A newly added workload is untrained and
+     * classifies every sample as within its class.
+     *
+     * @param self the registry object.
+     * @param key the workload identifier.
+     * @return the slot of the workload, or -1 if the registry is full.
+     */
+    int (*add)(struct registry_t *self, const char *key);
+
+    /**
+     * Train (or retrain) the classifier of a workload.
+     *
+     * @param self the registry object.
+     * @param slot the slot of the workload to train.
+     * @param samples the training feature set containing only data points of a single class.
+     * @param num_samples number of data points in the samples array.
+     */
+    void (*train)(struct registry_t *self, int slot, double samples[], size_t num_samples);
+
+    /**
+     * Set the classifier parameters of a workload directly.
+     *
+     * @param self the registry object.
+     * @param slot the slot of the workload.
+     * @param mean the mean of the workload's distribution.
+     * @param stddev the standard deviation of the workload's distribution.
+     * @return On success, returns 0. If a parameter is not finite, or the
+     *         standard deviation is negative, returns -1 and leaves the
+     *         workload unchanged.
+     */
+    int (*set_params)(struct registry_t *self, int slot, double mean, double stddev);
+
+    /**
+     * Check whether a workload has been trained, or had its parameters set,
+     * since it was added.
+     *
+     * @param self the registry object.
+     * @param slot the slot of the workload.
+     * @return 1 if the workload has a model, 0 if it is untrained.
+     */
+    int (*is_trained)(struct registry_t *self, int slot);
+
+    /**
+     * Get a consistent copy of the classifier parameters of a workload. The
+     * parameters of an untrained workload are both 0.
+     *
+     * @param self the registry object.
+     * @param slot the slot of the workload.
+     * @param mean on return, the mean of the workload's distribution.
+     * @param stddev on return, the standard deviation of the workload's distribution.
+     */
+    void (*get_params)(struct registry_t *self, int slot, double *mean, double *stddev);
+
+    /**
+     * Predict whether a sample is within the class of a workload.
+     *
+     * @param self the registry object.
+     * @param slot the slot of the workload.
+     * @param sample the sample to classify.
+     * @return 1 if sample is within the class, 0 otherwise.
+     */
+    int (*classify)(struct registry_t *self, int slot, double sample);
+
+    /**
+     * Classify many samples at once. Sample i is classified against the
+     * workload in slots[i]. Every slot must be valid.
+     *
+     * @param self the registry object.
+     * @param slots the slot of the workload of each sample.
+     * @param samples the samples to classify.
+     * @param predictions on return, 1 if sample i is within its class, 0 otherwise.
+     * @param num_samples number of entries in slots, samples and predictions.
+     */
+    void (*classify_batch)(struct registry_t *self, const int slots[], const double samples[],
+        int predictions[], size_t num_samples);
+
+    /**
+     * Number of workloads in the registry.
+     */
+    size_t (*size)(struct registry_t *self);
+
+    /**
+     * Get the identifier of the workload in a slot.
+     */
+    const char *(*get_key)(struct registry_t *self, int slot);
+};
+
+/**
+ * Create a new registry object able to hold up to capacity workloads.
+ */
+struct registry_t *create_registry(size_t capacity);
+
+/**
+ * Free up the resources allocated for a registry object.
+ */
+void delete_registry(struct registry_t *registry);
+
+/**
+ * Save the parameters of every trained workload in the registry to a snapshot
+ * file. The file is replaced atomically. See snapshot.h.
+ *
+ * @param registry the registry object.
+ * @param path where to install the snapshot.
+ * @return On success, returns 0. On error, returns -1.
+ */
+int save_registry(struct registry_t *registry, const char *path);
+
+/**
+ * Load workload parameters from a snapshot file into the registry. Workloads
+ * missing from the registry are added and existing ones are retrained in
+ * place, so this can be used to hot reload a registry that is being read.
+ * Records with a non-finite or negative parameter are skipped.
+ *
+ * @param registry the registry object.
+ * @param path the snapshot file.
+ * @return On success, returns the number of workloads loaded. On error, returns -1.
+ */
+int load_registry(struct registry_t *registry, const char *path);
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef SCORE_PIPELINE_H
+#define SCORE_PIPELINE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <math.h>
+#include "mem_util.h"
+#include "stats_util.h"
+
+//=============================================================================
+// Compile-time specialized scoring.
+//
+// The classifier and stats objects dispatch every call through function
+// pointers, which the compiler can't inline. This header provides the same
+// steps as small static inline building blocks, and DEFINE_SCORE_PIPELINE
+// stitches one extractor, one scorer and one sink into a loop in which all
+// three are inlined. The function pointer API stays available for code that
+// picks its parts at run time.
+//
+// Extractors: extract_<name>(const input_t *input, double base) -> double
+// Scorers:    <name>_score(struct <name>_scorer_t *scorer, double x) -> 1 if
+//             x is within the class, 0 otherwise
+// Sinks:      <name>_sink(struct <name>_sink_t *sink, size_t i, double x,
+//             int actual, int predicted)
+//=============================================================================
+
+/**
+ * Define a function that scores an array of inputs:
+ *
+ *   static void name(const input_type inputs[], const int actual[], size_t n, double base,
+ *       struct scorer_scorer_t *scorer, struct sink_sink_t *sink);
+ *
+ * Each input is turned into a feature by extract_<extract> with baseline
+ * base, classified by <scorer>_score and passed to <sink>_sink along with its
+ * index and actual class. actual may be NULL if the sink doesn't use it.
+ *
+ * For example, DEFINE_SCORE_PIPELINE(score_data, struct statm_t, data, zscore, counts)
+ * scores the data + stack pages of statm samples against a gaussian and
+ * tallies a confusion matrix.
+ */
+#define DEFINE_SCORE_PIPELINE(name, input_type, extract, scorer, sink)                          \
+    static inline void name(const input_type inputs[], const int actual[], size_t n, double base, \
+        struct scorer##_scorer_t *scorer_state, struct sink##_sink_t *sink_state)               \
+    {                                                                                           \
+        double x;                                                                               \
+        for (size_t i = 0; i < n; i++)                                                          \
+        {                                                                                       \
+            x = extract_##extract(&inputs[i], base);                                            \
+            sink##_sink(sink_state, i, x, (actual == NULL) ? 1 : actual[i],                     \
+                scorer##_score(scorer_state, x));                                               \
+        }                                                                                       \
+    }
+
+//=============================================================================
+// EXTRACTORS:
+//=============================================================================
+
+/**
+ * Data + stack pages of a statm sample above a baseline, the feature ./main
+ * classifies.
+ */
+static inline double extract_data(const struct statm_t *statm, double base)
+{
+    return (double) statm->data - base;
+}
+
+/**
+ * An already measured peak above a baseline.
+ */
+static inline double extract_peak(const unsigned long *peak, double base)
+{
+    return (double) *peak - base;
+}
+
+//=============================================================================
+// SCORERS:
+//=============================================================================
+
+/**
+ * One sided z-score test, equivalent to gaussian_occ_t::classify: a sample
+ * more than thresh standard deviations above the mean is outside the class.
+ * The bound is precomputed so that scoring is a single comparison.
+ */
+struct zscore_scorer_t
+{
+    double upper; // mean + thresh * stddev
+};
+
+static inline void init_zscore_scorer(struct zscore_scorer_t *scorer, double mean, double stddev, double thresh)
+{
+    scorer->upper = mean + thresh * stddev;
+}
+
+static inline int zscore_score(struct zscore_scorer_t *scorer, double x)
+{
+    return x > scorer->upper ? 0 : 1;
+}
+
+/**
+ * Mahalanobis distance test. For a single feature the distance is |z|, so
+ * unlike the z-score test, samples far below the mean are outside the class
+ * as well.
+ */
+struct mahalanobis_scorer_t
+{
+    double lower; // mean - thresh * stddev
+    double upper; // mean + thresh * stddev
+};
+
+static inline void init_mahalanobis_scorer(struct mahalanobis_scorer_t *scorer, double mean, double stddev,
+    double thresh)
+{
+    scorer->lower = mean - thresh * stddev;
+    scorer->upper = mean + thresh * stddev;
+}
+
+static inline int mahalanobis_score(struct mahalanobis_scorer_t *scorer, double x)
+{
+    return (x < scorer->lower) || (x > scorer->upper) ? 0 : 1;
+}
+
+/**
+ * Z-score test against an exponentially weighted moving mean and variance,
+ * so the class follows slow drift in the workload. Samples within the class
+ * update the averages with weight alpha; anomalies don't.
+ */
+struct ewma_scorer_t
+{
+    double mean;     // moving mean
+    double var;      // moving variance
+    double alpha;    // weight of a new sample
+    double thresh2;  // thresh squared
+};
+
+static inline void init_ewma_scorer(struct ewma_scorer_t *scorer, double mean, double stddev, double thresh,
+    double alpha)
+{
+    scorer->mean    = mean;
+    scorer->var     = stddev * stddev;
+    scorer->alpha   = alpha;
+    scorer->thresh2 = thresh * thresh;
+}
+
+static inline int ewma_score(struct ewma_scorer_t *scorer, double x)
+{
+    double d = x - scorer->mean;
+
+    if ((d > 0) && (d * d > scorer->thresh2 * scorer->var))
+        return 0;
+
+    scorer->mean += scorer->alpha * d;
+    scorer->var   = (1 - scorer->alpha) * (scorer->var + scorer->alpha * d * d);
+    return 1;
+}
+
+//=============================================================================
+// SINKS:
+//=============================================================================
+
+/**
+ * Confusion matrix counts. Fold them into a stats object with
+ * flush_counts_sink.
+ */
+struct counts_sink_t
+{
+    unsigned long tp;
+    unsigned long fn;
+    unsigned long fp;
+    unsigned long tn;
+};
+
+static inline void init_counts_sink(struct counts_sink_t *sink)
+{
+    sink->tp = sink->fn = sink->fp = sink->tn = 0;
+}
+
+static inline void counts_sink(struct counts_sink_t *sink, size_t i, double x, int actual, int predicted)
+{
+    // Branch free, since predictions are hard to predict right after a
+    // workload changes.
+    sink->tp += actual & predicted;
+    sink->fn += actual & !predicted;
+    sink->fp += (!actual) & predicted;
+    sink->tn += (!actual) & !predicted;
+}
+
+static inline void flush_counts_sink(struct counts_sink_t *sink, struct stats_t *stats)
+{
+    stats->add_counts(stats, sink->tp, sink->fn, sink->fp, sink->tn);
+    init_counts_sink(sink);
+}
+
+/**
+ * Histogram of the features, one per predicted class. Features outside
+ * [lo, lo + num_bins * width) are counted in the first or last bin.
+ */
+struct histogram_sink_t
+{
+    double         lo;        // lower edge of the first bin
+    double         inv_width; // 1 / bin width
+    size_t         num_bins;  // number of bins per class
+    unsigned long *bins[2];   // bins[prediction][bin], num_bins each
+};
+
+/**
+ * Initialize a histogram sink over bins, which must hold 2 * num_bins
+ * counters: the first num_bins for prediction 0, the rest for prediction 1.
+ * The counters are cleared.
+ */
+static inline void init_histogram_sink(struct histogram_sink_t *sink, double lo, double width, size_t num_bins,
+    unsigned long bins[])
+{
+    sink->lo        = lo;
+    sink->inv_width = 1 / width;
+    sink->num_bins  = num_bins;
+    sink->bins[0]   = bins;
+    sink->bins[1]   = bins + num_bins;
+
+    for (size_t i = 0; i < 2 * num_bins; i++)
+        bins[i] = 0;
+}
+
+static inline void histogram_sink(struct histogram_sink_t *sink, size_t i, double x, int actual, int predicted)
+{
+    double b = (x - sink->lo) * sink->inv_width;
+    size_t bin;
+
+    bin = (b <= 0) ? 0 : (b >= (double) (sink->num_bins - 1)) ? sink->num_bins - 1 : (size_t) b;
+    sink->bins[predicted != 0][bin]++;
+}
+
+/**
+ * Writes "index feature prediction" lines, in the format of data/mem.data.
+ */
+struct writer_sink_t
+{
+    FILE   *out;   // where the lines are written
+    size_t  first; // index of the first sample
+};
+
+static inline void init_writer_sink(struct writer_sink_t *sink, FILE *out, size_t first)
+{
+    sink->out   = out;
+    sink->first = first;
+}
+
+static inline void writer_sink(struct writer_sink_t *sink, size_t i, double x, int actual, int predicted)
+{
+    fprintf(sink->out, "%zu %.0f %d\n", sink->first + i, x, predicted);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Statistics object the simulation records its results in. See stats_util.h.
+ */
+struct stats_t;
+
+/**
+ * Settings for a simulated run. The distributions and the switch-over point
+ * have the same meaning as the command line arguments of ./main.
+ */
+struct sim_config_t
+{
+    long     thresh;        // number of samples after which to use the second distribution
+    double   mu_1;          // mean of the first distribution (pages)
+    double   sigma_1;       // standard deviation of the first distribution (pages)
+    double   mu_2;          // mean of the second distribution (pages)
+    double   sigma_2;       // standard deviation of the second distribution (pages)
+    size_t   train_samples; // number of leading samples used to train the classifier
+    size_t   total_samples; // total number of samples to simulate
+    double   noise_sigma;   // standard deviation of the measurement noise (pages)
+    double   miss_prob;     // probability that the sampler misses a process' peak
+    uint64_t seed;          // seed of the pseudo random number generator
+};
+
+/**
+ * Run the train/classify/stats pipeline of ./main in-process, drawing each
+ * "measured" peak straight from the configured distributions instead of
+ * forking a child and sampling it.
+ *
+ * The true peak of sample i is drawn from the first distribution if
+ * i < thresh and from the second otherwise. Negative draws are clamped to 0,
+ * like a child whose allocation failed. The measured peak then gets gaussian
+ * noise with standard deviation noise_sigma, and with probability miss_prob
+ * the sampler misses the peak and only sees a uniformly random fraction of
+ * it. The first train_samples samples train the classifier and every later
+ * sample is classified and recorded in stats with its true distribution as
+ * the actual class.
+ *
+ * Runs with equal configurations produce identical results.
+ *
+ * @param config settings for the run.
+ * @param stats statistics object the classifications are recorded in.
+ * @param out if not NULL, receives one "iter peak prediction" line per sample,
+ * in the format of data/mem.data.
+ * @return On success, returns 0. On error, or if there are no samples left
+ * to classify after training, returns -1.
+ */
+int run_sim(const struct sim_config_t *config, struct stats_t *stats, FILE *out);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * Magic bytes at the start of every snapshot file.
+ */
+#define SNAPSHOT_MAGIC "GLYT"
+
+/**
+ * Version of the snapshot file format. Bump whenever the layout of the
+ * header or of any payload changes; files with another version are rejected.
+ */
+#define SNAPSHOT_VERSION (1)
+
+/**
+ * Kinds of payload a snapshot can hold.
+ */
+#define SNAPSHOT_KIND_CLASSIFIER (1)
+#define SNAPSHOT_KIND_REGISTRY   (2)
+
+/**
+ * Header at the start of a snapshot file. All fields are stored in the
+ * native byte order of the machine that wrote the snapshot. The payload
+ * immediately follows the header.
+ */
+struct snapshot_header_t
+{
+    char     magic[4];     // SNAPSHOT_MAGIC
+    uint32_t version;      // SNAPSHOT_VERSION
+    uint32_t kind;         // one of SNAPSHOT_KIND_*
+    uint32_t num_records;  // number of models in the payload
+    uint64_t payload_size; // size of the payload in bytes
+    uint32_t checksum;     // CRC-32 of the payload
+    uint32_t reserved;     // always 0
+};
+
+/**
+ * A snapshot file mapped into memory.
+ */
+struct snapshot_t
+{
+    void                           *map;      // start of the mapping
+    size_t                          map_size; // size of the mapping in bytes
+    const struct snapshot_header_t *header;   // header at the start of the mapping
+    const void                     *payload;  // payload following the header
+};
+
+/**
+ * Identifies the file currently installed at a snapshot path, so that a
+ * reader can tell when it has been swapped for a new one.
+ */
+struct snapshot_stamp_t
+{
+    dev_t dev;
+    ino_t ino;
+};
+
+/**
+ * Computes the CRC-32 (IEEE 802.3) of a buffer, as stored in snapshot
+ * headers. Safe to call from several threads.
+ */
+uint32_t snapshot_crc32(const void *buf, size_t size);
+
+/**
+ * Atomically write a snapshot. The snapshot is written to a temporary file
+ * next to path which is then renamed over path, so readers see either the
+ * previous snapshot or the new one, never a partially written file.
+ *
+ * @param path where to install the snapshot.
+ * @param kind the kind of payload, one of SNAPSHOT_KIND_*.
+ * @param num_records number of models in the payload.
+ * @param payload the serialized models.
+ * @param payload_size size of the payload in bytes.
+ * @return On success, returns 0. On error, returns -1.
+ */
+int write_snapshot(const char *path, uint32_t kind, uint32_t num_records,
+    const void *payload, size_t payload_size);
+
+/**
+ * Map a snapshot into memory and validate its header and checksum.
+ *
+ * @param path the snapshot file.
+ * @param kind the kind of payload expected, one of SNAPSHOT_KIND_*.
+ * @param snapshot on success, describes the mapped snapshot.
+ * @return On success, returns 0. On error, returns -1.
+ */
+int map_snapshot(const char *path, uint32_t kind, struct snapshot_t *snapshot);
+
+/**
+ * Unmap a snapshot previously mapped by map_snapshot.
+ */
+void unmap_snapshot(struct snapshot_t *snapshot);
+
+/**
+ * Check whether the snapshot installed at path has been replaced since the
+ * last call, and update stamp to describe the file installed now. A stamp
+ * should be zero initialized before its first use.
+ *
+ * @param path the snapshot file.
+ * @param stamp the file seen by the previous call.
+ * @return 1 if a different file is installed at path, 0 otherwise.
+ */
+int snapshot_changed(const char *path, struct snapshot_stamp_t *stamp);
+
+#endif
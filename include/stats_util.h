@@ -9,6 +9,11 @@
  */
 struct stats_data_t;
 
+/**
+ * Arena the stats object can be allocated from. See arena.h.
+ */
+struct arena_t;
+
 /**
  * Struct with data and methods for computing statistics about data samples.
  */
@@ -25,6 +30,19 @@ struct stats_t
      */
     void (*add_stat)(struct stats_t *self, int actual, int predicted);
 
+    /**
+     * Add many statistics at once, e.g. counts tallied by a specialized
+     * score pipeline (see score_pipeline.h).
+     *
+     * @param self the stats object.
+     * @param tp number of true positives.
+     * @param fn number of false negatives.
+     * @param fp number of false positives.
+     * @param tn number of true negatives.
+     */
+    void (*add_counts)(struct stats_t *self, unsigned long tp, unsigned long fn,
+        unsigned long fp, unsigned long tn);
+
     /**
      * Prints the Confusion Matrix base on the current statistics.
      */ 
@@ -56,6 +74,12 @@ struct stats_t
  */
 struct stats_t *create_stats(void);
 
+/**
+ * Allocate and initialize stats_t object inside an arena. The object is
+ * released together with the arena and must not be passed to delete_stats.
+ */
+struct stats_t *create_stats_in(struct arena_t *arena);
+
 /**
  * Deallocate dynamically allocated resources for stats_t object.
  */
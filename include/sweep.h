@@ -0,0 +1,78 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Values a swept parameter takes: start, start + step, ... up to stop. A
+ * range with step <= 0 or stop <= start holds only start. In a random search
+ * the parameter is instead drawn uniformly from [start, stop].
+ */
+struct sweep_range_t
+{
+    double start;
+    double stop;
+    double step;
+};
+
+/**
+ * Description of a parameter sweep, read from a spec file by
+ * parse_sweep_spec. Every configuration is evaluated with run_sim.
+ */
+struct sweep_spec_t
+{
+    struct sweep_range_t thresh;
+    struct sweep_range_t mu_1;
+    struct sweep_range_t sigma_1;
+    struct sweep_range_t mu_2;
+    struct sweep_range_t sigma_2;
+    size_t               train;        // leading samples used for training per configuration
+    size_t               samples;      // samples simulated per configuration
+    uint64_t             seed;         // seed of every simulation
+    double               noise_sigma;  // measurement noise of every simulation
+    double               miss_prob;    // peak miss probability of every simulation
+    size_t               random_count; // number of random configurations, 0 for a grid search
+    uint64_t             random_seed;  // seed used to draw random configurations
+};
+
+/**
+ * Read a sweep spec file. Each non-empty line that doesn't start with '#'
+ * sets one setting:
+ *
+ *   thresh|mu_1|sigma_1|mu_2|sigma_2 start [stop [step]]
+ *   train n
+ *   samples n
+ *   seed n
+ *   noise sigma
+ *   miss prob
+ *   random count [seed]
+ *
+ * Settings that are not given are left unchanged, so the caller can fill
+ * in defaults before parsing.
+ *
+ * @param path the spec file.
+ * @param spec on success, holds the sweep description.
+ * @return On success, returns 0. On error, returns -1.
+ */
+int parse_sweep_spec(const char *path, struct sweep_spec_t *spec);
+
+/**
+ * Evaluate every configuration of a sweep in parallel and write a table of
+ * accuracy, recall, precision and F1-score to out.
+ *
+ * Each configuration runs as an independent simulation with its own state.
+ * If cache_path is not NULL, every finished configuration is appended to it
+ * as soon as it completes, and configurations already in it are not run
+ * again, so an interrupted sweep resumes where it stopped.
+ *
+ * @param spec the sweep description.
+ * @param num_jobs number of configurations evaluated at the same time.
+ * @param cache_path file of finished configurations, or NULL.
+ * @param out where the table is written.
+ * @return On success, returns 0. On error, returns -1.
+ */
+int run_sweep(const struct sweep_spec_t *spec, size_t num_jobs, const char *cache_path, FILE *out);
+
+#endif
@@ -0,0 +1,277 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/arena.h"
+
+//-----------------------------------------------------------------------------
+// Rounds n up to the next multiple of ARENA_ALIGNMENT.
+//-----------------------------------------------------------------------------
+#define ALIGN_UP(n) (((n) + (ARENA_ALIGNMENT - 1)) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+//-----------------------------------------------------------------------------
+// A chunk of memory obtained from malloc. The usable bytes of the chunk
+// follow the header, starting at CHUNK_HEADER_SIZE bytes from its start.
+//-----------------------------------------------------------------------------
+struct arena_chunk_t
+{
+    struct arena_chunk_t *next; // next chunk in the arena
+    size_t                size; // number of usable bytes in the chunk
+    size_t                used; // number of usable bytes handed out
+};
+
+#define CHUNK_HEADER_SIZE ALIGN_UP(sizeof(struct arena_chunk_t))
+#define CHUNK_BYTES(c)    ((char *) (c) + CHUNK_HEADER_SIZE)
+
+//-----------------------------------------------------------------------------
+// Private data members of arena_t object.
+//-----------------------------------------------------------------------------
+struct arena_data_t
+{
+    size_t                chunk_size; // default number of usable bytes per chunk
+    size_t                mallocs;    // number of calls made to malloc
+    struct arena_chunk_t *head;       // first chunk in the arena
+    struct arena_chunk_t *current;    // chunk allocations are carved from
+    void                 *last;       // most recent allocation
+};
+
+//-----------------------------------------------------------------------------
+// The arena object and its private data live in a single allocation.
+//-----------------------------------------------------------------------------
+struct arena_block_t
+{
+    struct arena_t      arena;
+    struct arena_data_t data;
+};
+
+//-----------------------------------------------------------------------------
+// Allocate a new chunk with at least size usable bytes and link it into the
+// arena right after the current chunk, so chunks that were reset and are
+// waiting to be reused stay reachable.
+//-----------------------------------------------------------------------------
+static struct arena_chunk_t *add_chunk(struct arena_data_t *data, size_t size)
+{
+    struct arena_chunk_t *chunk;
+
+    if (size < data->chunk_size)
+        size = data->chunk_size;
+
+    if ((chunk = (struct arena_chunk_t *) malloc(CHUNK_HEADER_SIZE + size)) == NULL)
+        return NULL;
+
+    data->mallocs++;
+    chunk->size = size;
+    chunk->used = 0;
+
+    if (data->current == NULL)
+    {
+        chunk->next = NULL;
+        data->head = chunk;
+    }
+    else
+    {
+        chunk->next = data->current->next;
+        data->current->next = chunk;
+    }
+
+    data->current = chunk;
+    return chunk;
+}
+
+//-----------------------------------------------------------------------------
+// Allocate a block of memory from the arena.
+//
+// @param arena the arena object.
+// @param size number of bytes to allocate.
+// @return pointer to the block, or NULL if out of memory.
+//-----------------------------------------------------------------------------
+static void *arena_alloc(struct arena_t *arena, size_t size)
+{
+    struct arena_data_t  *data  = arena->data;
+    struct arena_chunk_t *chunk = data->current;
+    void                 *ptr;
+
+    size = ALIGN_UP(size);
+
+    // Move on to chunks left over from before the last reset until one of
+    // them has room, and only fall back to malloc when none of them do.
+    while ((chunk != NULL) && (chunk->size - chunk->used < size))
+        chunk = chunk->next;
+
+    if (chunk != NULL)
+        data->current = chunk;
+    else if ((chunk = add_chunk(data, size)) == NULL)
+        return NULL;
+
+    ptr = CHUNK_BYTES(chunk) + chunk->used;
+    chunk->used += size;
+    data->last = ptr;
+
+    return ptr;
+}
+
+//-----------------------------------------------------------------------------
+// Resize a block previously returned by alloc.
+//
+// @param arena the arena object.
+// @param ptr the block to resize, or NULL to allocate a new block.
+// @param old_size current size of the block in bytes.
+// @param new_size requested size of the block in bytes.
+// @return pointer to the resized block, or NULL if out of memory.
+//-----------------------------------------------------------------------------
+static void *arena_realloc(struct arena_t *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    struct arena_data_t  *data  = arena->data;
+    struct arena_chunk_t *chunk = data->current;
+    size_t                offset;
+    void                 *new_ptr;
+
+    if (ptr == NULL)
+        return arena_alloc(arena, new_size);
+
+    if (new_size <= old_size)
+        return ptr;
+
+    // Grow in place when ptr is the most recent allocation and the rest of
+    // the current chunk is large enough to hold the new size.
+    if (ptr == data->last)
+    {
+        offset = (size_t) ((char *) ptr - CHUNK_BYTES(chunk));
+        if (chunk->size - offset >= ALIGN_UP(new_size))
+        {
+            chunk->used = offset + ALIGN_UP(new_size);
+            return ptr;
+        }
+    }
+
+    if ((new_ptr = arena_alloc(arena, new_size)) == NULL)
+        return NULL;
+
+    memcpy(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+//-----------------------------------------------------------------------------
+// Release every allocation made from the arena at once.
+//-----------------------------------------------------------------------------
+static void arena_reset(struct arena_t *arena)
+{
+    struct arena_data_t *data = arena->data;
+
+    for (struct arena_chunk_t *chunk = data->head; chunk != NULL; chunk = chunk->next)
+        chunk->used = 0;
+
+    data->current = data->head;
+    data->last = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Number of times the arena has called malloc since it was created.
+//-----------------------------------------------------------------------------
+static size_t arena_num_mallocs(struct arena_t *arena)
+{
+    return arena->data->mallocs;
+}
+
+//-----------------------------------------------------------------------------
+// Create a new arena object.
+//
+// @param chunk_size number of bytes to request from malloc at a time.
+//-----------------------------------------------------------------------------
+struct arena_t *create_arena(size_t chunk_size)
+{
+    // Allocate the arena and its private data together.
+    struct arena_block_t *block = (struct arena_block_t *) malloc(sizeof(struct arena_block_t));
+
+    if (block == NULL)
+        return NULL;
+
+    block->arena.data       = &block->data;
+    block->data.chunk_size  = ALIGN_UP(chunk_size);
+    block->data.mallocs     = 1;
+    block->data.head        = NULL;
+    block->data.current     = NULL;
+    block->data.last        = NULL;
+
+    // Allocate the first chunk up front so the first allocations are cheap.
+    if (add_chunk(&block->data, block->data.chunk_size) == NULL)
+    {
+        free(block);
+        return NULL;
+    }
+
+    // Attach public methods.
+    block->arena.alloc       = &arena_alloc;
+    block->arena.realloc     = &arena_realloc;
+    block->arena.reset       = &arena_reset;
+    block->arena.num_mallocs = &arena_num_mallocs;
+
+    return &block->arena;
+}
+
+//-----------------------------------------------------------------------------
+// Free up all the chunks owned by the arena and the arena object itself.
+//-----------------------------------------------------------------------------
+void delete_arena(struct arena_t *arena)
+{
+    struct arena_chunk_t *chunk;
+    struct arena_chunk_t *next;
+
+    if (arena != NULL)
+    {
+        for (chunk = arena->data->head; chunk != NULL; chunk = next)
+        {
+            next = chunk->next;
+            free(chunk);
+        }
+        // The arena is the first member of its block, so this frees the
+        // private data as well.
+        free(arena);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Initialize a sample buffer with room for cap samples.
+//
+// @param buf the sample buffer to initialize.
+// @param arena the arena to allocate the storage from.
+// @param cap initial number of samples the buffer can hold.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+int init_sample_buf(struct sample_buf_t *buf, struct arena_t *arena, size_t cap)
+{
+    if (cap == 0)
+        cap = 1;
+
+    buf->arena   = arena;
+    buf->len     = 0;
+    buf->cap     = cap;
+    buf->samples = (double *) arena->alloc(arena, sizeof(double) * cap);
+
+    return buf->samples == NULL ? -1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Append a sample to the buffer, doubling its capacity when it is full.
+//
+// @param buf the sample buffer.
+// @param sample the sample to append.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+int sample_buf_push(struct sample_buf_t *buf, double sample)
+{
+    double *samples;
+
+    if (buf->len == buf->cap)
+    {
+        samples = (double *) buf->arena->realloc(buf->arena, buf->samples,
+            sizeof(double) * buf->cap, 2 * sizeof(double) * buf->cap);
+
+        if (samples == NULL)
+            return -1;
+
+        buf->samples = samples;
+        buf->cap *= 2;
+    }
+
+    buf->samples[buf->len++] = sample;
+    return 0;
+}
@@ -93,14 +93,32 @@ int init_dist_info(int argc, char *argv[])
     char buf[32];
 
     // Validate that there are enough args.
-    if (argc != 6)
+    if ((argc < 6) || (argc > 10))
     {
-        puts("Usage: ./main thresh mu_1 sigma_1 mu_2 sigma_2\n");
+        puts("Usage: ./main thresh mu_1 sigma_1 mu_2 sigma_2 [model [min_us [max_us [budget]]]]");
+        puts("       ./main watch [model [min_us [max_us [budget]]]]");
+        puts("       ./main sim thresh mu_1 sigma_1 mu_2 sigma_2 [samples [seed [noise [miss]]]]");
+        puts("       ./main sweep spec [jobs [cache]]");
+        puts("       ./main history dir [from [to [workload [model]]]]\n");
         puts("\tthresh  - number of iterations after which to suse the second distribution");
         puts("\tmu_1    - mean of the first distribution");
         puts("\tsigma_1 - standard deviation of the first distribution");
         puts("\tmu_2    - mean of the second distribution");
         puts("\tsigma_2 - standard deviation of the second distribution");
+        puts("\tmodel   - optional classifier snapshot to load instead of training,");
+        puts("\t          or to save the trained classifier to if it doesn't exist; - for none");
+        puts("\tmin_us  - shortest time between two samples of a process, used while its");
+        puts("\t          memory usage is changing; at least 1 (default 100, or 10000 in watch mode)");
+        puts("\tmax_us  - longest time between two samples, backed off to while it is flat");
+        puts("\t          (default 5000, or 1000000 in watch mode)");
+        puts("\tbudget  - most samples taken per process, 0 for no limit (default 0)");
+        puts("\twatch   - watch every new process on the host instead (requires root),");
+        puts("\t          optionally loading and saving per-workload models from model,");
+        puts("\t          and reloading them whenever a new snapshot is installed there");
+        puts("\tsim     - simulate the children in-process; run ./main sim for details");
+        puts("\tsweep   - simulate a grid of configurations in parallel; run ./main sweep for details");
+        puts("\thistory - print (and train on) the samples recorded in data/history by earlier runs;");
+        puts("\t          run ./main history for details");
         return -1;
     }
 
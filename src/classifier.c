@@ -1,6 +1,9 @@
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "../include/classifier.h"
+#include "../include/arena.h"
+#include "../include/snapshot.h"
 
 
 //-----------------------------------------------------------------------------
@@ -14,34 +17,47 @@ struct gaussian_occ_data_t
 };
 
 //-----------------------------------------------------------------------------
-// Trains the one class classifier on a training set.
-// 
-// @param classifier the classifier object to train.
-// @param samples the training feature set containing only data points of a single class.
+// Fits a gaussian to a set of samples.
+//
+// @param samples the data points to fit.
 // @param num_samples number of data points in the samples array.
+// @param mean on return, the sample mean.
+// @param stddev on return, the sample standard deviation.
 //-----------------------------------------------------------------------------
-static void train(struct gaussian_occ_t *classifier, double samples[], size_t num_sample)
+void gaussian_occ_fit(const double samples[], size_t num_sample, double *mean, double *stddev)
 {
-    double mean = 0;
-    double stddev = 0;
+    double m = 0;
+    double s = 0;
     // Compute smaple mean
     for (int i = 0; i < num_sample; ++i)
     {
-        mean += samples[i];
+        m += samples[i];
     }
-    mean /= num_sample;
+    m /= num_sample;
 
     // Compute sample standard deviation
     for (int i = 0; i < num_sample; ++i)
     {
-        stddev += (samples[i] - mean) * (samples[i] - mean);
+        s += (samples[i] - m) * (samples[i] - m);
     }
-    stddev /= num_sample;
-    stddev = sqrt(stddev);
+    s /= num_sample;
+    s = sqrt(s);
+
+    *mean = m;
+    *stddev = s;
+}
 
+//-----------------------------------------------------------------------------
+// Trains the one class classifier on a training set.
+// 
+// @param classifier the classifier object to train.
+// @param samples the training feature set containing only data points of a single class.
+// @param num_samples number of data points in the samples array.
+//-----------------------------------------------------------------------------
+static void train(struct gaussian_occ_t *classifier, double samples[], size_t num_sample)
+{
     // Store trained values in classifer
-    classifier->data->mean = mean;
-    classifier->data->stddev = stddev;
+    gaussian_occ_fit(samples, num_sample, &classifier->data->mean, &classifier->data->stddev);
 }
 
 //-----------------------------------------------------------------------------
@@ -55,34 +71,66 @@ static void train(struct gaussian_occ_t *classifier, double samples[], size_t nu
 static int classify(struct gaussian_occ_t *classifier, double sample)
 {
     double z_score = (sample - classifier->data->mean) / classifier->data->stddev;
-    return z_score > 3 ? 0 : 1;
+    return z_score > GAUSSIAN_OCC_Z_THRESH ? 0 : 1;
 }
 
 //-----------------------------------------------------------------------------
-// Create a new gaussian one class classifier object.
+// Get the parameters of a trained classifier.
+//
+// @param classifier the trained classifier object.
+// @param mean on return, the mean of the class.
+// @param stddev on return, the standard deviation of the class.
 //-----------------------------------------------------------------------------
-struct gaussian_occ_t *create_classifier(void)
+void gaussian_occ_get_params(const struct gaussian_occ_t *classifier, double *mean, double *stddev)
 {
-    // Allocate memory for classifier struct.
-    struct gaussian_occ_t *classifier = (struct gaussian_occ_t *) malloc(sizeof(struct gaussian_occ_t));
-    
-    if (classifier == NULL)
-        return NULL;
+    *mean   = classifier->data->mean;
+    *stddev = classifier->data->stddev;
+}
 
-    // Allocate memory for classifier private data.
-    classifier->data = (struct gaussian_occ_data_t *) malloc(sizeof(struct gaussian_occ_data_t));
+//-----------------------------------------------------------------------------
+// The classifier object and its private data live in a single allocation so
+// that a classify call touches one cache-friendly block of memory.
+//-----------------------------------------------------------------------------
+struct gaussian_occ_block_t
+{
+    struct gaussian_occ_t      classifier;
+    struct gaussian_occ_data_t data;
+};
 
-    if (classifier->data == NULL)
-    {
-        delete_classifier(classifier);
+//-----------------------------------------------------------------------------
+// Initialize a freshly allocated classifier block.
+//-----------------------------------------------------------------------------
+static struct gaussian_occ_t *init_classifier(struct gaussian_occ_block_t *block)
+{
+    if (block == NULL)
         return NULL;
-    }
+
+    block->classifier.data = &block->data;
+    block->data.mean   = 0;
+    block->data.stddev = 0;
 
     // Attach public methods.
-    classifier->train = &train;
-    classifier->classify = &classify;
+    block->classifier.train = &train;
+    block->classifier.classify = &classify;
+
+    return &block->classifier;
+}
 
-    return classifier;
+//-----------------------------------------------------------------------------
+// Create a new gaussian one class classifier object.
+//-----------------------------------------------------------------------------
+struct gaussian_occ_t *create_classifier(void)
+{
+    // Allocate memory for classifier struct and its private data.
+    return init_classifier((struct gaussian_occ_block_t *) malloc(sizeof(struct gaussian_occ_block_t)));
+}
+
+//-----------------------------------------------------------------------------
+// Create a new gaussian one class classifier object inside an arena.
+//-----------------------------------------------------------------------------
+struct gaussian_occ_t *create_classifier_in(struct arena_t *arena)
+{
+    return init_classifier((struct gaussian_occ_block_t *) arena->alloc(arena, sizeof(struct gaussian_occ_block_t)));
 }
 
 //-----------------------------------------------------------------------------
@@ -90,14 +138,49 @@ struct gaussian_occ_t *create_classifier(void)
 //-----------------------------------------------------------------------------
 void delete_classifier(struct gaussian_occ_t *classifier)
 {
+    // The classifier is the first member of its block, so this frees the
+    // private data as well.
     if (classifier != NULL)
     {
-        // Free data first because if we free classifier first, we'll lose
-        // pointer to the data struct.
-        if (classifier->data != NULL)
-        {
-            free(classifier->data);
-        }
         free(classifier);
     }
-}
\ No newline at end of file
+}
+
+//-----------------------------------------------------------------------------
+// Save the parameters of a trained classifier to a snapshot file.
+//
+// @param classifier the trained classifier object.
+// @param path where to install the snapshot.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+int save_classifier(struct gaussian_occ_t *classifier, const char *path)
+{
+    return write_snapshot(path, SNAPSHOT_KIND_CLASSIFIER, 1,
+        classifier->data, sizeof(struct gaussian_occ_data_t));
+}
+
+//-----------------------------------------------------------------------------
+// Load the parameters of a classifier from a snapshot file.
+//
+// @param classifier the classifier object to load the parameters into.
+// @param path the snapshot file.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+int load_classifier(struct gaussian_occ_t *classifier, const char *path)
+{
+    struct snapshot_t snapshot;
+
+    if (map_snapshot(path, SNAPSHOT_KIND_CLASSIFIER, &snapshot) == -1)
+        return -1;
+
+    if ((snapshot.header->num_records != 1) ||
+        (snapshot.header->payload_size != sizeof(struct gaussian_occ_data_t)))
+    {
+        unmap_snapshot(&snapshot);
+        return -1;
+    }
+
+    memcpy(classifier->data, snapshot.payload, sizeof(struct gaussian_occ_data_t));
+    unmap_snapshot(&snapshot);
+    return 0;
+}
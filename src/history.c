@@ -0,0 +1,791 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "../include/history.h"
+#include "../include/snapshot.h"
+#include "../include/arena.h"
+
+//-----------------------------------------------------------------------------
+// Magic number at the start of every block header ("GLYH").
+//-----------------------------------------------------------------------------
+#define BLOCK_MAGIC (0x48594c47)
+
+//-----------------------------------------------------------------------------
+// Largest encoded payload of a block: a table of up to one workload per
+// record and five varints per record, none longer than 10 bytes.
+//-----------------------------------------------------------------------------
+#define MAX_PAYLOAD_SIZE (10 + HISTORY_BLOCK_RECORDS * (5 + 5 * 10))
+
+//-----------------------------------------------------------------------------
+// Initial number of index entries.
+//-----------------------------------------------------------------------------
+#define INITIAL_INDEX_CAP (64)
+
+//-----------------------------------------------------------------------------
+// Header written in front of every compressed block. It is also the index
+// entry of the block, so queries can skip blocks without reading them. All
+// fields are stored in native byte order.
+//-----------------------------------------------------------------------------
+struct block_header_t
+{
+    uint32_t magic;        // BLOCK_MAGIC
+    uint32_t count;        // number of records in the block
+    uint32_t payload_size; // size of the compressed payload in bytes
+    uint32_t checksum;     // CRC-32 of the payload
+    int64_t  min_ts;       // smallest timestamp in the block
+    int64_t  max_ts;       // largest timestamp in the block
+    uint64_t bloom;        // bloom filter of the block's workloads
+};
+
+//-----------------------------------------------------------------------------
+// Where a block lives.
+//-----------------------------------------------------------------------------
+struct block_index_t
+{
+    uint32_t              segment; // segment file number
+    uint64_t              offset;  // offset of the block header in the segment
+    struct block_header_t header;
+};
+
+//-----------------------------------------------------------------------------
+// Private data used by the history store.
+//-----------------------------------------------------------------------------
+struct history_data_t
+{
+    char                     dir[4096];
+    struct arena_t          *arena;
+
+    // Sparse index: the header of every block written so far.
+    struct block_index_t    *index;
+    size_t                   num_blocks;
+    size_t                   index_cap;
+
+    // Segment new blocks are appended to.
+    uint32_t                 segment;
+    uint64_t                 segment_size;
+    int                      fd;
+
+    // Records not written out yet.
+    struct history_record_t *pending;
+    size_t                   num_pending;
+
+    // Scratch space for encoding and decoding blocks.
+    uint8_t                 *payload;
+    struct history_record_t *decoded;
+    uint32_t                *workloads;
+};
+
+//-----------------------------------------------------------------------------
+// The history object and its private data are allocated together.
+//-----------------------------------------------------------------------------
+struct history_block_t
+{
+    struct history_t      history;
+    struct history_data_t data;
+};
+
+//-----------------------------------------------------------------------------
+// Variable length integers: 7 bits per byte, least significant first, with
+// the high bit set on every byte but the last. Signed values are zigzag
+// encoded first so that small negative numbers stay short.
+//-----------------------------------------------------------------------------
+static uint8_t *put_varint(uint8_t *p, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        *p++ = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t) value;
+    return p;
+}
+
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *value)
+{
+    uint64_t result = 0;
+
+    for (int shift = 0; (p < end) && (shift < 64); shift += 7)
+    {
+        result |= (uint64_t) (*p & 0x7F) << shift;
+        if ((*p++ & 0x80) == 0)
+        {
+            *value = result;
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+static uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+//-----------------------------------------------------------------------------
+// The two bloom filter bits of a workload.
+//-----------------------------------------------------------------------------
+static uint64_t bloom_bits(uint32_t workload)
+{
+    return (1ULL << (workload & 63)) | (1ULL << ((workload >> 6) & 63));
+}
+
+//-----------------------------------------------------------------------------
+// Builds the path of a segment file.
+//-----------------------------------------------------------------------------
+static void segment_path(const struct history_data_t *data, uint32_t segment, char path[4096 + 16])
+{
+    snprintf(path, 4096 + 16, "%s/%08u.seg", data->dir, segment);
+}
+
+//-----------------------------------------------------------------------------
+// Adds a block to the index.
+//
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+static int add_index(struct history_data_t *data, uint32_t segment, uint64_t offset,
+    const struct block_header_t *header)
+{
+    struct block_index_t *index;
+
+    if (data->num_blocks == data->index_cap)
+    {
+        index = (struct block_index_t *) data->arena->realloc(data->arena, data->index,
+            data->index_cap * sizeof(struct block_index_t),
+            2 * data->index_cap * sizeof(struct block_index_t));
+        if (index == NULL)
+            return -1;
+        data->index      = index;
+        data->index_cap *= 2;
+    }
+
+    data->index[data->num_blocks].segment = segment;
+    data->index[data->num_blocks].offset  = offset;
+    data->index[data->num_blocks].header  = *header;
+    data->num_blocks++;
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Compresses the pending records into data->payload and fills in the header.
+//-----------------------------------------------------------------------------
+static void encode_block(struct history_data_t *data, struct block_header_t *header)
+{
+    const struct history_record_t *records = data->pending;
+    uint8_t                       *p;
+    size_t                         num_workloads = 0;
+    size_t                         w = 0;
+    int64_t                        prev_ts;
+    int64_t                        prev_delta = 0;
+    int64_t                        prev_pid = 0;
+    int64_t                        prev_peak = 0;
+
+    header->magic  = BLOCK_MAGIC;
+    header->count  = data->num_pending;
+    header->min_ts = records[0].timestamp;
+    header->max_ts = records[0].timestamp;
+    header->bloom  = 0;
+
+    // Table of the distinct workloads in the block. Consecutive records
+    // usually share a workload, so check the last hit first.
+    for (size_t i = 0; i < data->num_pending; i++)
+    {
+        if ((num_workloads == 0) || (data->workloads[w] != records[i].workload))
+        {
+            for (w = 0; (w < num_workloads) && (data->workloads[w] != records[i].workload); w++)
+                ;
+            if (w == num_workloads)
+            {
+                data->workloads[num_workloads++] = records[i].workload;
+                header->bloom |= bloom_bits(records[i].workload);
+            }
+        }
+
+        if (header->min_ts > records[i].timestamp)
+            header->min_ts = records[i].timestamp;
+        if (header->max_ts < records[i].timestamp)
+            header->max_ts = records[i].timestamp;
+    }
+
+    p = put_varint(data->payload, num_workloads);
+    for (size_t i = 0; i < num_workloads; i++)
+        p = put_varint(p, data->workloads[i]);
+
+    // Samples are taken at a roughly steady rate, so the delta of the
+    // timestamp deltas is usually close to zero.
+    prev_ts = header->min_ts;
+    w       = 0;
+
+    for (size_t i = 0; i < data->num_pending; i++)
+    {
+        int64_t delta = records[i].timestamp - prev_ts;
+
+        if (data->workloads[w] != records[i].workload)
+        {
+            for (w = 0; data->workloads[w] != records[i].workload; w++)
+                ;
+        }
+
+        p = put_varint(p, zigzag(delta - prev_delta));
+        p = put_varint(p, zigzag((int64_t) records[i].pid - prev_pid));
+        p = put_varint(p, w);
+        p = put_varint(p, zigzag((int64_t) records[i].peak - prev_peak));
+        // The flags get a varint of their own, a single byte, so the peak
+        // delta keeps all 64 bits.
+        p = put_varint(p, ((records[i].training != 0) << 1) | (records[i].prediction != 0));
+
+        prev_ts    = records[i].timestamp;
+        prev_delta = delta;
+        prev_pid   = records[i].pid;
+        prev_peak  = (int64_t) records[i].peak;
+    }
+
+    header->payload_size = p - data->payload;
+    header->checksum     = snapshot_crc32(data->payload, header->payload_size);
+}
+
+//-----------------------------------------------------------------------------
+// Decompresses a block payload into data->decoded.
+//
+// @return On success, returns 0. If the payload is corrupt, returns -1.
+//-----------------------------------------------------------------------------
+static int decode_block(struct history_data_t *data, const struct block_header_t *header)
+{
+    const uint8_t *p   = data->payload;
+    const uint8_t *end = data->payload + header->payload_size;
+    uint64_t       num_workloads;
+    uint64_t       v[5];
+    int64_t        prev_ts = header->min_ts;
+    int64_t        prev_delta = 0;
+    int64_t        prev_pid = 0;
+    int64_t        prev_peak = 0;
+
+    if (((p = get_varint(p, end, &num_workloads)) == NULL) || (num_workloads > HISTORY_BLOCK_RECORDS))
+        return -1;
+
+    for (size_t i = 0; i < num_workloads; i++)
+    {
+        if ((p = get_varint(p, end, &v[0])) == NULL)
+            return -1;
+        data->workloads[i] = (uint32_t) v[0];
+    }
+
+    for (size_t i = 0; i < header->count; i++)
+    {
+        for (int k = 0; k < 5; k++)
+        {
+            if ((p = get_varint(p, end, &v[k])) == NULL)
+                return -1;
+        }
+
+        if ((v[2] >= num_workloads) || (v[4] > 3))
+            return -1;
+
+        prev_delta += unzigzag(v[0]);
+        prev_ts    += prev_delta;
+        prev_pid   += unzigzag(v[1]);
+        prev_peak  += unzigzag(v[3]);
+
+        data->decoded[i].timestamp  = prev_ts;
+        data->decoded[i].pid        = (int32_t) prev_pid;
+        data->decoded[i].workload   = data->workloads[v[2]];
+        data->decoded[i].peak       = (uint64_t) prev_peak;
+        data->decoded[i].prediction = (int) (v[4] & 1);
+        data->decoded[i].training   = (int) ((v[4] >> 1) & 1);
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Opens the segment new blocks are appended to, starting a new one if the
+// current segment is full.
+//
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+static int open_segment(struct history_data_t *data)
+{
+    char path[4096 + 16];
+
+    if ((data->fd != -1) && (data->segment_size < HISTORY_SEGMENT_BYTES))
+        return 0;
+
+    if (data->fd != -1)
+    {
+        fsync(data->fd);
+        close(data->fd);
+        data->fd = -1;
+    }
+
+    if (data->segment_size >= HISTORY_SEGMENT_BYTES)
+    {
+        data->segment++;
+        data->segment_size = 0;
+    }
+
+    segment_path(data, data->segment, path);
+    if ((data->fd = open(path, O_CREAT | O_WRONLY | O_APPEND | O_CLOEXEC, 0644)) == -1)
+        return -1;
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Compresses the pending records and appends them to the current segment as
+// one block.
+//
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+static int write_block(struct history_data_t *data)
+{
+    struct block_header_t header;
+    struct iovec          iov[2];
+    ssize_t               size;
+
+    if (data->num_pending == 0)
+        return 0;
+
+    if (open_segment(data) == -1)
+        return -1;
+
+    encode_block(data, &header);
+
+    iov[0].iov_base = &header;
+    iov[0].iov_len  = sizeof(header);
+    iov[1].iov_base = data->payload;
+    iov[1].iov_len  = header.payload_size;
+    size            = sizeof(header) + header.payload_size;
+
+    // A short write leaves a torn block that the next open cuts off, so
+    // there is nothing to undo here.
+    if ((writev(data->fd, iov, 2) != size) ||
+        (add_index(data, data->segment, data->segment_size, &header) == -1))
+        return -1;
+
+    data->segment_size += size;
+    data->num_pending   = 0;
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Add a record.
+//
+// @param self the history object.
+// @param record the record to add.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+static int append(struct history_t *self, const struct history_record_t *record)
+{
+    struct history_data_t *data = self->data;
+
+    if ((data->num_pending == HISTORY_BLOCK_RECORDS) && (write_block(data) == -1))
+        return -1;
+
+    data->pending[data->num_pending++] = *record;
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Write out the buffered records and sync the segment file to disk.
+//
+// @param self the history object.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+static int flush(struct history_t *self)
+{
+    struct history_data_t *data = self->data;
+
+    if (write_block(data) == -1)
+        return -1;
+
+    return ((data->fd == -1) || (fsync(data->fd) == 0)) ? 0 : -1;
+}
+
+//-----------------------------------------------------------------------------
+// Visits the records of an array that match a query.
+//
+// @param stopped set if visit asked to stop the query.
+// @return the number of records visited.
+//-----------------------------------------------------------------------------
+static long visit_records(const struct history_record_t *records, size_t count, int64_t from, int64_t to,
+    uint32_t workload, history_visit_t visit, void *arg, int *stopped)
+{
+    long visited = 0;
+
+    for (size_t i = 0; (i < count) && !*stopped; i++)
+    {
+        if ((records[i].timestamp < from) || (records[i].timestamp >= to) ||
+            ((workload != HISTORY_ALL_WORKLOADS) && (records[i].workload != workload)))
+            continue;
+
+        visited++;
+        *stopped = (visit(&records[i], arg) != 0);
+    }
+
+    return visited;
+}
+
+//-----------------------------------------------------------------------------
+// Visit the records with from <= timestamp < to of a workload.
+//
+// @param self the history object.
+// @param from start of the time range in milliseconds.
+// @param to end of the time range in milliseconds.
+// @param workload workload id to match, or HISTORY_ALL_WORKLOADS.
+// @param visit called for every matching record.
+// @param arg passed to visit.
+// @return the number of records visited, or -1 on error.
+//-----------------------------------------------------------------------------
+static long query(struct history_t *self, int64_t from, int64_t to, uint32_t workload,
+    history_visit_t visit, void *arg)
+{
+    struct history_data_t       *data = self->data;
+    const struct block_index_t  *entry;
+    char                         path[4096 + 16];
+    uint32_t                     open_segment_num = 0;
+    int                          fd = -1;
+    int                          stopped = 0;
+    long                         visited = 0;
+
+    for (size_t b = 0; (b < data->num_blocks) && !stopped; b++)
+    {
+        entry = &data->index[b];
+
+        // Use the index to skip blocks that can't hold a match.
+        if ((entry->header.max_ts < from) || (entry->header.min_ts >= to) ||
+            ((workload != HISTORY_ALL_WORKLOADS) &&
+             ((entry->header.bloom & bloom_bits(workload)) != bloom_bits(workload))))
+            continue;
+
+        if ((fd == -1) || (open_segment_num != entry->segment))
+        {
+            if (fd != -1)
+                close(fd);
+
+            segment_path(data, entry->segment, path);
+            open_segment_num = entry->segment;
+            if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+                return -1;
+        }
+
+        if ((pread(fd, data->payload, entry->header.payload_size, entry->offset + sizeof(struct block_header_t))
+                != entry->header.payload_size) ||
+            (snapshot_crc32(data->payload, entry->header.payload_size) != entry->header.checksum) ||
+            (decode_block(data, &entry->header) == -1))
+        {
+            close(fd);
+            return -1;
+        }
+
+        visited += visit_records(data->decoded, entry->header.count, from, to, workload, visit, arg, &stopped);
+    }
+
+    if (fd != -1)
+        close(fd);
+
+    // Records that haven't been written out yet come last.
+    visited += visit_records(data->pending, data->num_pending, from, to, workload, visit, arg, &stopped);
+
+    return visited;
+}
+
+//-----------------------------------------------------------------------------
+// Compares segment numbers for qsort.
+//-----------------------------------------------------------------------------
+static int compare_segments(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+//-----------------------------------------------------------------------------
+// Reads the block headers of a segment into the index. In the last segment,
+// a block that is incomplete or fails its checksum was torn by a crash and
+// is cut off; anywhere else the rest of the segment is skipped.
+//
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+static int index_segment(struct history_data_t *data, uint32_t segment, int is_last)
+{
+    struct block_header_t header;
+    struct stat           st;
+    char                  path[4096 + 16];
+    uint64_t              offset = 0;
+    int                   fd;
+    int                   torn;
+
+    segment_path(data, segment, path);
+    if (((fd = open(path, (is_last ? O_RDWR : O_RDONLY) | O_CLOEXEC)) == -1) || (fstat(fd, &st) == -1))
+    {
+        if (fd != -1)
+            close(fd);
+        return -1;
+    }
+
+    while (offset < (uint64_t) st.st_size)
+    {
+        torn = (pread(fd, &header, sizeof(header), offset) != sizeof(header)) ||
+            (header.magic != BLOCK_MAGIC) ||
+            (header.count == 0) || (header.count > HISTORY_BLOCK_RECORDS) ||
+            (header.payload_size > MAX_PAYLOAD_SIZE) ||
+            (offset + sizeof(header) + header.payload_size > (uint64_t) st.st_size);
+
+        // Only the last block can have been torn by a crash, and only its
+        // checksum is checked here to keep opening a long history cheap.
+        // Queries check the checksum of every block they read.
+        if (!torn && is_last && (offset + sizeof(header) + header.payload_size == (uint64_t) st.st_size))
+        {
+            torn = (pread(fd, data->payload, header.payload_size, offset + sizeof(header)) != header.payload_size) ||
+                (snapshot_crc32(data->payload, header.payload_size) != header.checksum);
+        }
+
+        if (torn)
+        {
+            if (is_last && (ftruncate(fd, offset) == -1))
+            {
+                close(fd);
+                return -1;
+            }
+            break;
+        }
+
+        if (add_index(data, segment, offset, &header) == -1)
+        {
+            close(fd);
+            return -1;
+        }
+
+        offset += sizeof(header) + header.payload_size;
+    }
+
+    close(fd);
+
+    if (is_last)
+    {
+        data->segment      = segment;
+        data->segment_size = offset;
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Reads the index of every segment in the history directory.
+//
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+static int load_index(struct history_data_t *data)
+{
+    DIR           *dir;
+    struct dirent *ent;
+    uint32_t      *segments = NULL;
+    uint32_t      *grown;
+    size_t         num_segments = 0;
+    size_t         cap = 0;
+    unsigned       segment;
+    char           suffix;
+    int            ret = 0;
+
+    if ((dir = opendir(data->dir)) == NULL)
+        return -1;
+
+    while ((ent = readdir(dir)) != NULL)
+    {
+        // Only names of the form NNNNNNNN.seg are segments.
+        if ((strlen(ent->d_name) != 12) || (sscanf(ent->d_name, "%8u.se%c", &segment, &suffix) != 2) ||
+            (suffix != 'g'))
+            continue;
+
+        if (num_segments == cap)
+        {
+            cap = cap ? 2 * cap : 16;
+            if ((grown = (uint32_t *) realloc(segments, cap * sizeof(uint32_t))) == NULL)
+            {
+                ret = -1;
+                break;
+            }
+            segments = grown;
+        }
+        segments[num_segments++] = segment;
+    }
+
+    closedir(dir);
+
+    if (ret == 0)
+    {
+        qsort(segments, num_segments, sizeof(uint32_t), &compare_segments);
+
+        for (size_t i = 0; (i < num_segments) && (ret == 0); i++)
+            ret = index_segment(data, segments[i], i == num_segments - 1);
+    }
+
+    free(segments);
+    return ret;
+}
+
+//-----------------------------------------------------------------------------
+// Open a history store, creating its directory if needed.
+//
+// @param dir directory holding the segment files.
+// @return On success, returns a pointer to a history object. On error, returns NULL.
+//-----------------------------------------------------------------------------
+struct history_t *open_history(const char *dir)
+{
+    struct history_block_t *block;
+    struct history_data_t  *data;
+
+    if ((strlen(dir) >= sizeof(data->dir)) || ((mkdir(dir, 0755) == -1) && (errno != EEXIST)))
+        return NULL;
+
+    if ((block = (struct history_block_t *) malloc(sizeof(struct history_block_t))) == NULL)
+        return NULL;
+
+    data = &block->data;
+    block->history.data = data;
+
+    if ((data->arena = create_arena(ARENA_DEFAULT_CHUNK_SIZE)) == NULL)
+    {
+        free(block);
+        return NULL;
+    }
+
+    strcpy(data->dir, dir);
+    data->num_blocks   = 0;
+    data->index_cap    = INITIAL_INDEX_CAP;
+    data->segment      = 0;
+    data->segment_size = 0;
+    data->fd           = -1;
+    data->num_pending  = 0;
+    data->index        = (struct block_index_t *) data->arena->alloc(data->arena, INITIAL_INDEX_CAP * sizeof(struct block_index_t));
+    data->pending      = (struct history_record_t *) data->arena->alloc(data->arena, HISTORY_BLOCK_RECORDS * sizeof(struct history_record_t));
+    data->decoded      = (struct history_record_t *) data->arena->alloc(data->arena, HISTORY_BLOCK_RECORDS * sizeof(struct history_record_t));
+    data->workloads    = (uint32_t *) data->arena->alloc(data->arena, HISTORY_BLOCK_RECORDS * sizeof(uint32_t));
+    data->payload      = (uint8_t *) data->arena->alloc(data->arena, MAX_PAYLOAD_SIZE);
+
+    if ((data->index == NULL) || (data->pending == NULL) || (data->decoded == NULL) ||
+        (data->workloads == NULL) || (data->payload == NULL) || (load_index(data) == -1))
+    {
+        delete_arena(data->arena);
+        free(block);
+        return NULL;
+    }
+
+    // Attach public methods.
+    block->history.append = &append;
+    block->history.flush  = &flush;
+    block->history.query  = &query;
+
+    return &block->history;
+}
+
+//-----------------------------------------------------------------------------
+// Flush and close a history store and free its memory.
+//-----------------------------------------------------------------------------
+void close_history(struct history_t *history)
+{
+    struct history_data_t *data;
+
+    if (history == NULL)
+        return;
+
+    data = history->data;
+    flush(history);
+
+    if (data->fd != -1)
+        close(data->fd);
+
+    delete_arena(data->arena);
+    free(history);
+}
+
+//-----------------------------------------------------------------------------
+// Returns the current wall clock time in milliseconds.
+//-----------------------------------------------------------------------------
+int64_t history_now(void)
+{
+    struct timespec tp;
+    clock_gettime(CLOCK_REALTIME, &tp);
+    return (int64_t) tp.tv_sec * 1000 + tp.tv_nsec / 1000000;
+}
+
+//-----------------------------------------------------------------------------
+// Map a workload identifier to the id stored in records (32 bit FNV-1a).
+//-----------------------------------------------------------------------------
+uint32_t history_workload_id(const char *key)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*key != '\0')
+    {
+        hash ^= (uint8_t) *key++;
+        hash *= 16777619u;
+    }
+
+    return (hash == HISTORY_ALL_WORKLOADS) ? 1 : hash;
+}
+
+//-----------------------------------------------------------------------------
+// State of history_load_samples.
+//-----------------------------------------------------------------------------
+struct collect_t
+{
+    struct sample_buf_t *samples;
+    long                 count;
+    int                  error;
+};
+
+//-----------------------------------------------------------------------------
+// Appends the peak of a record that trained a model to a sample buffer.
+// Stops the query if the buffer can't grow.
+//-----------------------------------------------------------------------------
+static int collect_sample(const struct history_record_t *record, void *arg)
+{
+    struct collect_t *collect = (struct collect_t *) arg;
+
+    if (!record->training)
+        return 0;
+
+    if (sample_buf_push(collect->samples, (double) record->peak) == -1)
+    {
+        collect->error = 1;
+        return 1;
+    }
+
+    collect->count++;
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Collect the peaks of the records of a workload in a time range that
+// trained a model.
+//
+// @param history the history object.
+// @param from start of the time range in milliseconds.
+// @param to end of the time range in milliseconds.
+// @param workload workload id to match, or HISTORY_ALL_WORKLOADS.
+// @param samples initialized sample buffer the peaks are appended to.
+// @return the number of peaks appended, or -1 on error.
+//-----------------------------------------------------------------------------
+long history_load_samples(struct history_t *history, int64_t from, int64_t to, uint32_t workload,
+    struct sample_buf_t *samples)
+{
+    struct collect_t collect = { .samples = samples, .count = 0, .error = 0 };
+
+    if ((history->query(history, from, to, workload, &collect_sample, &collect) == -1) || collect.error)
+        return -1;
+
+    return collect.count;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
@@ -8,13 +9,23 @@
 #include <sys/types.h>
 #include "../include/child_proc.h"
 #include "../include/mem_util.h"
+#include "../include/mem_sampler.h"
 #include "../include/classifier.h"
 #include "../include/stats_util.h"
+#include "../include/arena.h"
+#include "../include/registry.h"
+#include "../include/proc_watch.h"
+#include "../include/sim.h"
+#include "../include/sweep.h"
+#include "../include/history.h"
+#include "../include/score_pipeline.h"
 
 //=============================================================================
 // CONSTANTS:
 //=============================================================================
 #define MEM_DATA_FILEPATH    "data/mem.data"
+#define HISTORY_DIR          "data/history"
+#define HISTORY_WORKLOAD     "child_proc"
 #define KST_FULL_PATH        "/usr/bin/kst2"
 #define KST_CMD              "kst2"
 #define KST_XLABEL           "Child Proccess"
@@ -26,6 +37,365 @@
 #define D1_SAMPLES_START     250            
 #define D2_SAMPLES_START     500
 #define TOTAL_NUM_SAMPLES    1000
+#define SAMPLE_MIN_US        100
+#define SAMPLE_MAX_US        5000
+#define SAMPLE_BUDGET        0
+#define SAMPLE_ROLLUP_PAGES  0
+#define WATCH_MAX_TRACKED    65536
+#define WATCH_MAX_WORKLOADS  4096
+#define WATCH_SAMPLE_MIN_US  10000
+#define WATCH_SAMPLE_MAX_US  1000000
+#define WATCH_SAMPLE_BUDGET  0
+#define WATCH_REPORT_MS      5000
+#define WATCH_RCVBUF_BYTES   (32 * 1024 * 1024)
+#define WATCH_ROLLUP_PAGES   25600
+
+//=============================================================================
+// HELPERS:
+//=============================================================================
+
+//-----------------------------------------------------------------------------
+// Parses a whole argument as a non-negative decimal number.
+//
+// @return On success, returns 0. If arg is not a number, or is negative or out
+// of range, returns -1.
+//-----------------------------------------------------------------------------
+static int parse_count(const char *arg, long *value)
+{
+    char *end;
+
+    errno  = 0;
+    *value = strtol(arg, &end, 10);
+
+    return ((end == arg) || (*end != '\0') || (errno != 0) || (*value < 0)) ? -1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Reads the optional "[min_us [max_us [budget]]]" arguments that start at
+// argv[first] into config. Settings that are not given keep their defaults.
+// A min_us of 0 is rejected, since every round would then spin on its
+// processes without sleeping.
+//
+// @return On success, returns 0. If the settings are invalid, returns -1.
+//-----------------------------------------------------------------------------
+static int parse_sample_rate(int argc, char *argv[], int first, struct sample_rate_config_t *config)
+{
+    long budget = config->budget;
+
+    if (((argc > first) && (parse_count(argv[first], &config->min_interval_us) == -1)) ||
+        ((argc > first + 1) && (parse_count(argv[first + 1], &config->max_interval_us) == -1)) ||
+        ((argc > first + 2) && (parse_count(argv[first + 2], &budget) == -1)) ||
+        (config->min_interval_us == 0) || (config->max_interval_us < config->min_interval_us))
+    {
+        printf("Error: invalid sampling rate, need 0 < min_us <= max_us and budget >= 0\n");
+        return -1;
+    }
+
+    config->budget = budget;
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the model path argument at argv[index], or NULL if it is not given
+// or is "-", which skips it so the sampling rate can still be set.
+//-----------------------------------------------------------------------------
+static const char *model_arg(int argc, char *argv[], int index)
+{
+    return ((argc > index) && (strcmp(argv[index], "-") != 0)) ? argv[index] : NULL;
+}
+
+static void print_stats(struct stats_t *stats)
+{
+    stats->print_confusion_matrix(stats);
+    printf("Accuracy  = %0.8f\n", stats->get_accuracy(stats));
+    printf("Recall    = %0.8f\n", stats->get_recall(stats));
+    printf("Precision = %0.8f\n", stats->get_precision(stats));
+    printf("F1-score  = %0.8f\n", stats->get_f1_score(stats));
+}
+
+//=============================================================================
+// SCORING:
+//=============================================================================
+
+//-----------------------------------------------------------------------------
+// Sink of the fork loop: tallies the confusion matrix and keeps the last
+// prediction, which is written to data/mem.data and the history.
+//-----------------------------------------------------------------------------
+struct child_sink_t
+{
+    struct counts_sink_t counts;
+    int                  prediction;
+};
+
+static inline void child_sink(struct child_sink_t *sink, size_t i, double x, int actual, int predicted)
+{
+    counts_sink(&sink->counts, i, x, actual, predicted);
+    sink->prediction = predicted;
+}
+
+//-----------------------------------------------------------------------------
+// Scores the peak of a child with the inlined equivalents of classify and
+// add_stat.
+//-----------------------------------------------------------------------------
+DEFINE_SCORE_PIPELINE(score_child, unsigned long, peak, zscore, child)
+
+//=============================================================================
+// WATCH MODE:
+//=============================================================================
+static int watch_main(int argc, char *argv[])
+{
+    struct registry_t     *registry; // Per-workload classifiers
+    struct watch_stats_t   stats;    // Counters reported by watch mode
+    const char            *model;    // Snapshot of the workload models, or NULL
+    struct watch_config_t  config = {
+        .max_tracked         = WATCH_MAX_TRACKED,
+        .max_workloads       = WATCH_MAX_WORKLOADS,
+        .train_samples       = D1_SAMPLES_START,
+        .sample_rate         = {
+            .min_interval_us = WATCH_SAMPLE_MIN_US,
+            .max_interval_us = WATCH_SAMPLE_MAX_US,
+            .budget          = WATCH_SAMPLE_BUDGET,
+        },
+        .report_interval_ms  = WATCH_REPORT_MS,
+        .rcvbuf_bytes        = WATCH_RCVBUF_BYTES,
+        .rollup_thresh_pages = WATCH_ROLLUP_PAGES,
+    };
+    int                    ret;
+
+    if (parse_sample_rate(argc, argv, 3, &config.sample_rate) == -1)
+        return EXIT_FAILURE;
+
+    // One sampler thread per CPU.
+    config.num_samplers = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+
+    if ((registry = create_registry(config.max_workloads)) == NULL)
+    {
+        printf("Error: unable to allocate enough memory\n");
+        return EXIT_FAILURE;
+    }
+
+    if ((config.history = open_history(HISTORY_DIR)) == NULL)
+        fprintf(stderr, "[watch_main] Warning: unable to open history in %s\n", HISTORY_DIR);
+
+    // Start from previously trained workload models if there are any, and
+    // reload them whenever a new snapshot is installed.
+    if ((model = model_arg(argc, argv, 2)) != NULL)
+    {
+        config.snapshot_path = model;
+        ret = load_registry(registry, model);
+        fprintf(stderr, "Loaded %d workload models from %s\n", ret < 0 ? 0 : ret, model);
+    }
+
+    ret = run_watch(registry, &config, &stats);
+    print_watch_stats(&stats);
+
+    if ((model != NULL) && (save_registry(registry, model) == -1))
+        printf("[watch_main] Warning: unable to save workload models to %s\n", model);
+
+    close_history(config.history);
+    delete_registry(registry);
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//=============================================================================
+// SIMULATION MODE:
+//=============================================================================
+static int sim_main(int argc, char *argv[])
+{
+    struct stats_t      *stats;  // Object for working with statistics
+    struct timespec      start;  // Time the simulation started
+    struct timespec      end;    // Time the simulation ended
+    struct sim_config_t  config; // Settings for the simulation
+    size_t               total;  // Number of samples to simulate
+
+    // Only the samples after the training ones are scored, so there must be
+    // at least one of them.
+    total = argc > 7 ? strtoul(argv[7], NULL, 10) : TOTAL_NUM_SAMPLES;
+
+    if ((argc < 7) || (argc > 11) || (total <= D1_SAMPLES_START))
+    {
+        puts("Usage: ./main sim thresh mu_1 sigma_1 mu_2 sigma_2 [samples [seed [noise [miss]]]]\n");
+        puts("\tthresh..sigma_2 - same as for ./main");
+        printf("\tsamples - number of samples to simulate, more than %d (default %d)\n", D1_SAMPLES_START,
+            TOTAL_NUM_SAMPLES);
+        puts("\tseed    - seed of the random number generator (default 1)");
+        puts("\tnoise   - standard deviation of the measurement noise in pages (default 0)");
+        puts("\tmiss    - probability that the sampler misses a peak (default 0)");
+        return EXIT_FAILURE;
+    }
+
+    config.thresh        = atol(argv[2]);
+    config.mu_1          = atof(argv[3]);
+    config.sigma_1       = atof(argv[4]);
+    config.mu_2          = atof(argv[5]);
+    config.sigma_2       = atof(argv[6]);
+    config.train_samples = D1_SAMPLES_START;
+    config.total_samples = total;
+    config.seed          = argc > 8 ? strtoull(argv[8], NULL, 10) : 1;
+    config.noise_sigma   = argc > 9 ? atof(argv[9]) : 0;
+    config.miss_prob     = argc > 10 ? atof(argv[10]) : 0;
+
+    if ((stats = create_stats()) == NULL)
+    {
+        printf("Error: unable to allocate enough memory\n");
+        return EXIT_FAILURE;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (run_sim(&config, stats, NULL) == -1)
+    {
+        printf("Error: unable to run simulation\n");
+        delete_stats(stats);
+        return EXIT_FAILURE;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    print_stats(stats);
+    printf("Simulated %zu samples in %0.3f s\n", config.total_samples,
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);
+
+    delete_stats(stats);
+    return EXIT_SUCCESS;
+}
+
+//=============================================================================
+// SWEEP MODE:
+//=============================================================================
+static int sweep_main(int argc, char *argv[])
+{
+    long                 num_jobs;    // Number of configurations run in parallel
+    struct sweep_spec_t  spec = {     // Defaults for settings missing from the spec
+        .thresh       = { D2_SAMPLES_START, D2_SAMPLES_START, 0 },
+        .mu_1         = { 100, 100, 0 },
+        .sigma_1      = { 10, 10, 0 },
+        .mu_2         = { 300, 300, 0 },
+        .sigma_2      = { 10, 10, 0 },
+        .train        = D1_SAMPLES_START,
+        .samples      = TOTAL_NUM_SAMPLES,
+        .seed         = 1,
+        .noise_sigma  = 0,
+        .miss_prob    = 0,
+        .random_count = 0,
+        .random_seed  = 1,
+    };
+
+    if ((argc < 3) || (argc > 5))
+    {
+        puts("Usage: ./main sweep spec [jobs [cache]]\n");
+        puts("\tspec  - file describing the grid or random search (see include/sweep.h)");
+        puts("\tjobs  - number of configurations to simulate in parallel (default: number of cpus)");
+        puts("\tcache - file of finished configurations, used to resume an interrupted sweep");
+        return EXIT_FAILURE;
+    }
+
+    if (parse_sweep_spec(argv[2], &spec) == -1)
+        return EXIT_FAILURE;
+
+    num_jobs = argc > 3 ? atol(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (run_sweep(&spec, num_jobs > 0 ? num_jobs : 1, argc > 4 ? argv[4] : NULL, stdout) == -1)
+    {
+        printf("Error: sweep failed\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+//=============================================================================
+// HISTORY MODE:
+//=============================================================================
+static int print_record(const struct history_record_t *record, void *arg)
+{
+    printf("%lld %d %08x %llu %d %d\n", (long long) record->timestamp, (int) record->pid,
+        (unsigned) record->workload, (unsigned long long) record->peak, record->prediction, record->training);
+    return 0;
+}
+
+static int history_main(int argc, char *argv[])
+{
+    struct history_t      *history;      // Store the records are read from
+    struct gaussian_occ_t *classifier;   // Classifier trained from the records
+    struct arena_t        *arena;        // Arena owning the classifier and samples
+    struct sample_buf_t    samples;      // Peaks read back for training
+    int64_t                from;         // Start of the time range (ms)
+    int64_t                to;           // End of the time range (ms)
+    uint32_t               workload;     // Workload to read, or all of them
+    long                   num_records;  // Number of records printed
+    int                    ret = EXIT_SUCCESS;
+
+    if ((argc < 3) || (argc > 7))
+    {
+        puts("Usage: ./main history dir [from [to [workload [model]]]]\n");
+        printf("\tdir      - history directory (./main records into %s)\n", HISTORY_DIR);
+        puts("\tfrom, to - time range in milliseconds since the epoch (default everything)");
+        printf("\tworkload - command name of the workload, %s for ./main's children, or * for all\n", HISTORY_WORKLOAD);
+        puts("\tmodel    - train a classifier on the peaks that trained earlier models and save it");
+        puts("\t           to this snapshot");
+        return EXIT_FAILURE;
+    }
+
+    from     = argc > 3 ? strtoll(argv[3], NULL, 10) : INT64_MIN;
+    to       = argc > 4 ? strtoll(argv[4], NULL, 10) : INT64_MAX;
+    workload = ((argc > 5) && (strcmp(argv[5], "*") != 0)) ? history_workload_id(argv[5]) : HISTORY_ALL_WORKLOADS;
+
+    if ((history = open_history(argv[2])) == NULL)
+    {
+        printf("Error: unable to open history in %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    //-------------------------------------------------------------------------
+    // Print the records as "timestamp pid workload peak prediction training"
+    // lines.
+    //-------------------------------------------------------------------------
+    if ((num_records = history->query(history, from, to, workload, &print_record, NULL)) == -1)
+    {
+        printf("Error: history in %s is corrupt\n", argv[2]);
+        close_history(history);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "%ld records\n", num_records);
+
+    //-------------------------------------------------------------------------
+    // Train a classifier from the records instead of measuring again.
+    //-------------------------------------------------------------------------
+    if (argc == 7)
+    {
+        if (((arena = create_arena(ARENA_DEFAULT_CHUNK_SIZE)) == NULL) ||
+            ((classifier = create_classifier_in(arena)) == NULL) ||
+            (init_sample_buf(&samples, arena, D1_SAMPLES_START) == -1) ||
+            (history_load_samples(history, from, to, workload, &samples) == -1))
+        {
+            printf("Error: unable to allocate enough memory\n");
+            delete_arena(arena);
+            close_history(history);
+            return EXIT_FAILURE;
+        }
+
+        if (samples.len == 0)
+        {
+            printf("Error: no training records to train on\n");
+            ret = EXIT_FAILURE;
+        }
+        else
+        {
+            classifier->train(classifier, samples.samples, samples.len);
+            if (save_classifier(classifier, argv[6]) == -1)
+            {
+                printf("Error: unable to save classifier to %s\n", argv[6]);
+                ret = EXIT_FAILURE;
+            }
+            else
+                fprintf(stderr, "Trained on %zu peaks, saved to %s\n", samples.len, argv[6]);
+        }
+
+        delete_arena(arena);
+    }
+
+    close_history(history);
+    return ret;
+}
 
 //=============================================================================
 // MAIN:
@@ -35,24 +405,81 @@ int main(int argc, char *argv[])
     int                    fd_mem_data;    // File descriptor for memory usage output file
     int                    wstatus;        // Wait status of child processes
     int                    prediction;     // Classifier prediction 1 = D1, 0 = D2
+    int                    actual;         // Distribution the child was drawn from 1 = D1, 0 = D2
+    int                    model_loaded;   // Whether the classifier was loaded from a snapshot
+    const char            *model;          // Classifier snapshot to load or save, or NULL
     char                   buf[32];        // Miscelaneous use like writing data to files
     pid_t                  pid;            // Process ID of child processes
-    double                *train_samples;  // Array of samples used to train the classifier
+    struct sample_buf_t    train_samples;  // Samples used to train the classifier
     unsigned long          base_mem_usage; // Baseline memory usage of parent process
     unsigned long          mem_usage;      // Used in computing memory usage of child processes
-    struct statm_t         statm;          // Struct that stores data from /proc/[pid]/statm file
+    struct statm_t         statm = { 0 };  // Struct that stores data from /proc/[pid]/statm file
+    struct mem_sampler_t   sampler;        // Reads statm, and smaps_rollup at new resident highs
+    struct mem_sample_t    sample;         // Latest sample of the current child
+    unsigned long          peak_pss;       // Peak proportional set size of the current child (kB)
+    unsigned long          total_pss = 0;  // Sum of the peak PSS of all children (kB)
+    unsigned long          num_rollups = 0; // Total number of smaps_rollup reads of all children
     struct stats_t        *stats;          // Object for working with statistics
     struct gaussian_occ_t *classifier;     // Gaussian one class classifier
+    struct zscore_scorer_t scorer;         // Inlined equivalent of the trained classifier
+    struct child_sink_t    sink;           // Confusion matrix counts and the last prediction
+    double                 mean;           // Mean of the trained classifier
+    double                 stddev;         // Standard deviation of the trained classifier
+    struct arena_t        *arena;          // Arena owning the objects and samples below
+    struct history_t      *history;        // Long-term store of every sample
+    struct history_record_t record;        // Sample recorded in the history store
+    struct sample_rate_t   rate;           // Adaptive sampling rate of the current child
+    long                   interval;       // Time until the next sample of the child (us)
+    unsigned long          num_reads = 0;  // Total number of samples taken of all children
+    struct sample_rate_config_t rate_config = {
+        .min_interval_us = SAMPLE_MIN_US,
+        .max_interval_us = SAMPLE_MAX_US,
+        .budget          = SAMPLE_BUDGET,
+    };
+
+    //-------------------------------------------------------------------------
+    // Watch every process on the host instead of forking our own.
+    //-------------------------------------------------------------------------
+    if ((argc >= 2) && (argc <= 6) && (strcmp(argv[1], "watch") == 0))
+    {
+        return watch_main(argc, argv);
+    }
+
+    //-------------------------------------------------------------------------
+    // Simulate the children in-process instead of forking them.
+    //-------------------------------------------------------------------------
+    if ((argc >= 2) && (strcmp(argv[1], "sim") == 0))
+    {
+        return sim_main(argc, argv);
+    }
+
+    //-------------------------------------------------------------------------
+    // Evaluate many simulated configurations in parallel.
+    //-------------------------------------------------------------------------
+    if ((argc >= 2) && (strcmp(argv[1], "sweep") == 0))
+    {
+        return sweep_main(argc, argv);
+    }
+
+    //-------------------------------------------------------------------------
+    // Read back (and optionally train on) previously recorded samples.
+    //-------------------------------------------------------------------------
+    if ((argc >= 2) && (strcmp(argv[1], "history") == 0))
+    {
+        return history_main(argc, argv);
+    }
 
     //-------------------------------------------------------------------------
     // Initialize file containing information regarding the distirbutions D1
     // and D2 that child processes will use from the command line arguments.
     //-------------------------------------------------------------------------
-    if (init_dist_info(argc, argv) == -1)
+    if ((init_dist_info(argc, argv) == -1) || (parse_sample_rate(argc, argv, 7, &rate_config) == -1))
     {
         exit(EXIT_FAILURE);
     }
 
+    model = model_arg(argc, argv, 6);
+
     //-------------------------------------------------------------------------
     // Open file for writing memory usage data to use for analysis and plotting.
     // Create file if it doesn't already exists. If the file already exists,
@@ -91,6 +518,16 @@ int main(int argc, char *argv[])
     
     // Parent process
 
+    //-------------------------------------------------------------------------
+    // Open the history store every sample is recorded in, so that it is kept
+    // across runs. Open it before taking the baseline below, so its buffers
+    // aren't counted towards the children's memory usage.
+    //-------------------------------------------------------------------------
+    if ((history = open_history(HISTORY_DIR)) == NULL)
+    {
+        printf("[main] Warning: unable to open history in %s\n", HISTORY_DIR);
+    }
+
     //-------------------------------------------------------------------------
     // Get baseline memory usage of parent process. When we fork child process,
     // they will be copies of the parent process memory space, so they will
@@ -102,23 +539,49 @@ int main(int argc, char *argv[])
     base_mem_usage = statm.data;
     
     //-------------------------------------------------------------------------
-    // Initialize all the object and memory that will be needed.
+    // Initialize all the object and memory that will be needed. Everything
+    // is carved out of a single arena and released in one go.
     //-------------------------------------------------------------------------
-    stats         = create_stats();
-    classifier    = create_classifier();
-    train_samples = (double*) malloc(sizeof(double) * 1000);
+    if ((arena = create_arena(ARENA_DEFAULT_CHUNK_SIZE)) == NULL)
+    {
+        printf("Error: unable to allocate enough memory\n");
+        close_history(history);
+        close(fd_mem_data);
+        exit(EXIT_FAILURE);
+    }
+
+    stats      = create_stats_in(arena);
+    classifier = create_classifier_in(arena);
 
-    if ((classifier == NULL) || (train_samples == NULL) || (stats == NULL))
+    if ((classifier == NULL) || (stats == NULL) ||
+        (init_sample_buf(&train_samples, arena, D1_SAMPLES_START) == -1))
     {
         printf("Error: unable to allocate enough memory\n");
-        delete_stats(stats);
-        delete_classifier(classifier);
+        close_history(history);
+        delete_arena(arena);
         close(fd_mem_data);    
-        if (train_samples != NULL)
-            free(train_samples);
         exit(EXIT_FAILURE);
     }
 
+    //-------------------------------------------------------------------------
+    // If a model snapshot was given and it can be loaded, skip training and
+    // start classifying right away.
+    //-------------------------------------------------------------------------
+    model_loaded = (model != NULL) && (load_classifier(classifier, model) == 0);
+    init_counts_sink(&sink.counts);
+
+    // Like an untrained registry slot, accept everything until trained.
+    init_zscore_scorer(&scorer, 0, INFINITY, GAUSSIAN_OCC_Z_THRESH);
+
+    if (model_loaded)
+    {
+        gaussian_occ_get_params(classifier, &mean, &stddev);
+        init_zscore_scorer(&scorer, mean, stddev, GAUSSIAN_OCC_Z_THRESH);
+        printf("Loaded classifier from %s\n", model);
+        // Flush so the message isn't duplicated into every forked child.
+        fflush(stdout);
+    }
+
     //-------------------------------------------------------------------------
     // Create child processes and monitor their memory usage.
     //-------------------------------------------------------------------------
@@ -130,9 +593,8 @@ int main(int argc, char *argv[])
         if (pid < 0)
         {
             printf("Error: unable to fork process.");
-            delete_stats(stats);
-            delete_classifier(classifier);
-            free(train_samples);
+            close_history(history);
+            delete_arena(arena);
             close(fd_mem_data);    
             exit(EXIT_FAILURE);
         }
@@ -149,15 +611,54 @@ int main(int argc, char *argv[])
         // Determine memory usage of child process
         //---------------------------------------------------------------------
         mem_usage = 0;
+        peak_pss  = 0;
+
+        // Keep the child's files open while it runs, so that each sample is
+        // a single pread instead of an open, a read and a close. If the open
+        // fails, every read fails until the child is reaped.
+        open_mem_sampler(&sampler, pid, SAMPLE_ROLLUP_PAGES);
+
+        // Sample quickly while the child's memory usage is changing and back
+        // off while it is flat, instead of spinning on the child.
+        init_sample_rate(&rate, &rate_config);
 
         while(!waitpid(pid, &wstatus, WNOHANG))
         {
-            parse_statm(pid, &statm);
-            if (mem_usage < statm.data)
+            num_reads++;
+
+            // Only a successful read moves the rate; after a failed one,
+            // the sample is stale, so retry after the current interval.
+            if (mem_sampler_read(&sampler, pid, &sample) == -1)
+            {
+                usleep(rate.interval_us);
+                continue;
+            }
+
+            // The child allocates without touching its memory, so only the
+            // data size tells the two distributions apart. PSS is recorded
+            // to show what the child actually kept resident.
+            if (mem_usage < sample.statm.data)
             {
-                mem_usage = statm.data;
+                mem_usage = sample.statm.data;
             }
+
+            if (sample.has_rollup)
+            {
+                num_rollups++;
+                if (peak_pss < sample.rollup.pss)
+                    peak_pss = sample.rollup.pss;
+            }
+
+            if ((interval = next_sample_interval(&rate, sample.statm.data)) < 0)
+            {
+                waitpid(pid, &wstatus, 0);
+                break;
+            }
+            usleep(interval);
         }
+
+        close_mem_sampler(&sampler);
+        total_pss += peak_pss;
         
         // Correct for baseline memory usage of parent process
         mem_usage -= base_mem_usage;
@@ -165,28 +666,54 @@ int main(int argc, char *argv[])
         //---------------------------------------------------------------------
         // Train the gaussian one class classifier.
         //---------------------------------------------------------------------
-        if (iter < D1_SAMPLES_START)
+        if ((iter < D1_SAMPLES_START) && !model_loaded)
         {
-            train_samples[iter] = mem_usage;
+            if (sample_buf_push(&train_samples, mem_usage) == -1)
+            {
+                printf("Error: unable to allocate enough memory\n");
+                close_history(history);
+                delete_arena(arena);
+                close(fd_mem_data);
+                exit(EXIT_FAILURE);
+            }
             prediction = 1;
             if (iter == (D1_SAMPLES_START - 1))
-                classifier->train(classifier, train_samples, D1_SAMPLES_START);
+            {
+                classifier->train(classifier, train_samples.samples, train_samples.len);
+                gaussian_occ_get_params(classifier, &mean, &stddev);
+                init_zscore_scorer(&scorer, mean, stddev, GAUSSIAN_OCC_Z_THRESH);
+
+                // Save the baseline so the next run can skip training.
+                if ((model != NULL) && (save_classifier(classifier, model) == -1))
+                {
+                    printf("[main] Warning: unable to save classifier to %s\n", model);
+                    fflush(stdout);
+                }
+            }
         }
         //---------------------------------------------------------------------
-        // Classify samples: in this case, all samples are from distribution D1
+        // Classify samples: samples before D2_SAMPLES_START are from
+        // distribution D1, the rest from distribution D2
         //---------------------------------------------------------------------
-        else if ((iter >= D1_SAMPLES_START) && (iter < D2_SAMPLES_START))
+        else
         {
-            prediction = classifier->classify(classifier, (double) mem_usage);
-            stats->add_stat(stats, 1, prediction);
+            actual = (iter < D2_SAMPLES_START) ? 1 : 0;
+            score_child(&mem_usage, &actual, 1, 0, &scorer, &sink);
+            prediction = sink.prediction;
         }
+
         //---------------------------------------------------------------------
-        // Classify samples: in this case, all samples are from distribution D2
+        // Record the sample in the long-term history.
         //---------------------------------------------------------------------
-        else
+        if (history != NULL)
         {
-            prediction = classifier->classify(classifier, (double) mem_usage);
-            stats->add_stat(stats, 0, prediction);
+            record.timestamp  = history_now();
+            record.pid        = pid;
+            record.workload   = history_workload_id(HISTORY_WORKLOAD);
+            record.peak       = mem_usage;
+            record.prediction = prediction;
+            record.training   = (iter < D1_SAMPLES_START) && !model_loaded;
+            history->append(history, &record);
         }
 
         //---------------------------------------------------------------------
@@ -198,9 +725,8 @@ int main(int argc, char *argv[])
         {
             printf("[main] Error: unable to write to %s\n", MEM_DATA_FILEPATH);
             printf("exiting program...\n");
-            delete_stats(stats);
-            delete_classifier(classifier);
-            free(train_samples);
+            close_history(history);
+            delete_arena(arena);
             close(fd_mem_data);    
             exit(EXIT_FAILURE);
         }
@@ -209,18 +735,17 @@ int main(int argc, char *argv[])
     //-------------------------------------------------------------------------
     // Print out statistics
     //-------------------------------------------------------------------------    
-    stats->print_confusion_matrix(stats);
-    printf("Accuracy  = %0.8f\n", stats->get_accuracy(stats));
-    printf("Recall    = %0.8f\n", stats->get_recall(stats));
-    printf("Precision = %0.8f\n", stats->get_precision(stats));
-    printf("F1-score  = %0.8f\n", stats->get_f1_score(stats));
+    flush_counts_sink(&sink.counts, stats);
+    print_stats(stats);
+    printf("Reads     = %lu\n", num_reads);
+    printf("Rollups   = %lu\n", num_rollups);
+    printf("Peak PSS  = %lu kB per child\n", total_pss / TOTAL_NUM_SAMPLES);
 
     //-------------------------------------------------------------------------
     // Clean up
     //-------------------------------------------------------------------------
-    delete_stats(stats);
-    delete_classifier(classifier);
-    free(train_samples);
+    close_history(history);
+    delete_arena(arena);
     close(fd_mem_data);    
 
     return 0;
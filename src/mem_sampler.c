@@ -0,0 +1,132 @@
+#include <unistd.h>
+#include "../include/mem_sampler.h"
+
+//-----------------------------------------------------------------------------
+// Marks a sampler whose smaps_rollup could not be opened, so that opening
+// it is not retried on every sample.
+//-----------------------------------------------------------------------------
+#define ROLLUP_UNAVAILABLE (-2)
+
+//-----------------------------------------------------------------------------
+// Opens the files of process pid that a sampler reads.
+//
+// @param sampler the sampler to initialize.
+// @param pid process to sample.
+// @param rollup_thresh resident pages from which smaps_rollup is read.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+int open_mem_sampler(struct mem_sampler_t *sampler, pid_t pid, unsigned long rollup_thresh)
+{
+    sampler->rollup_fd       = -1;
+    sampler->rollup_thresh   = rollup_thresh;
+    sampler->rollup_resident = 0;
+
+    return ((sampler->statm_fd = open_statm(pid)) == -1) ? -1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Takes one sample: statm always, smaps_rollup only when the resident set is
+// above the threshold and at a new high since the previous rollup read.
+//
+// @param sampler a sampler initialized by open_mem_sampler.
+// @param pid the process passed to open_mem_sampler.
+// @param sample on success, holds the sample.
+// @return On success, returns 0. Otherwise, returns -1.
+//-----------------------------------------------------------------------------
+int mem_sampler_read(struct mem_sampler_t *sampler, pid_t pid, struct mem_sample_t *sample)
+{
+    unsigned long resident;
+
+    sample->has_rollup = 0;
+
+    if (read_statm(sampler->statm_fd, &sample->statm) == -1)
+        return -1;
+
+    resident = sample->statm.resident;
+    if ((sampler->rollup_thresh == MEM_SAMPLER_NO_ROLLUP) ||
+        (resident < sampler->rollup_thresh) ||
+        (resident <= sampler->rollup_resident) ||
+        (sampler->rollup_fd == ROLLUP_UNAVAILABLE))
+        return 0;
+
+    if ((sampler->rollup_fd == -1) && ((sampler->rollup_fd = open_smaps_rollup(pid)) == -1))
+    {
+        sampler->rollup_fd = ROLLUP_UNAVAILABLE;
+        return 0;
+    }
+
+    // The process may exit between the two reads; the statm sample is still
+    // good, so report it without the rollup.
+    if (read_smaps_rollup(sampler->rollup_fd, &sample->rollup) == 0)
+    {
+        sample->has_rollup       = 1;
+        sampler->rollup_resident = resident;
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Closes smaps_rollup after the process called exec, since the open file
+// still refers to its old address space. The new program may also be
+// readable where the old one was not, so an unavailable rollup is retried.
+//-----------------------------------------------------------------------------
+void reset_mem_sampler_rollup(struct mem_sampler_t *sampler)
+{
+    if (sampler->rollup_fd >= 0)
+        close(sampler->rollup_fd);
+
+    sampler->rollup_fd       = -1;
+    sampler->rollup_resident = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Closes the files opened by a sampler.
+//-----------------------------------------------------------------------------
+void close_mem_sampler(struct mem_sampler_t *sampler)
+{
+    if (sampler->statm_fd != -1)
+        close(sampler->statm_fd);
+
+    sampler->statm_fd = -1;
+    reset_mem_sampler_rollup(sampler);
+}
+
+//-----------------------------------------------------------------------------
+// Initializes the sampling rate of a new process at min_interval_us.
+//-----------------------------------------------------------------------------
+void init_sample_rate(struct sample_rate_t *rate, const struct sample_rate_config_t *config)
+{
+    rate->config      = config;
+    rate->interval_us = config->min_interval_us;
+    rate->samples     = 0;
+    rate->last        = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Records a sample and computes how long to wait before the next one: back
+// to the minimum interval if the value moved, twice the previous interval
+// (up to the maximum) if it didn't.
+//
+// @param rate the sampling rate of the process.
+// @param value the sampled value.
+// @return the time to wait in microseconds, or -1 once the budget is used up.
+//-----------------------------------------------------------------------------
+long next_sample_interval(struct sample_rate_t *rate, unsigned long value)
+{
+    const struct sample_rate_config_t *config = rate->config;
+
+    if ((++rate->samples >= config->budget) && (config->budget != 0))
+        return -1;
+
+    if (value != rate->last)
+        rate->interval_us = config->min_interval_us;
+    else if (rate->interval_us < config->max_interval_us)
+        rate->interval_us = (rate->interval_us > 0) ? 2 * rate->interval_us : 1;
+
+    if (rate->interval_us > config->max_interval_us)
+        rate->interval_us = config->max_interval_us;
+
+    rate->last = value;
+    return rate->interval_us;
+}
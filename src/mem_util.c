@@ -1,5 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include "../include/mem_util.h"
 
 //-----------------------------------------------------------------------------
@@ -33,3 +36,158 @@ int parse_statm(pid_t pid, struct statm_t *statm)
     fclose(pstatm);
     return 0;
 }
+
+//-----------------------------------------------------------------------------
+// Opens /proc/[pid]/statm so that it can be sampled repeatedly.
+//
+// @param pid process whose memory usage will be sampled.
+// @return On success, returns a file descriptor. Otherwise, returns -1.
+//-----------------------------------------------------------------------------
+int open_statm(pid_t pid)
+{
+    char filepath[32];
+    sprintf(filepath, "/proc/%d/statm", (int) pid);
+    return open(filepath, O_RDONLY | O_CLOEXEC);
+}
+
+//-----------------------------------------------------------------------------
+// Reads and parses /proc/[pid]/statm through a file descriptor returned by
+// open_statm. The kernel regenerates the contents on every read from offset
+// 0, so a single pread gives a fresh sample.
+//
+// @param fd file descriptor returned by open_statm.
+// @param statm on success, will be updated with the current memory usage of the process.
+// @return If the file is parsed successfully, return 0. Otherwise, returns -1.
+//-----------------------------------------------------------------------------
+int read_statm(int fd, struct statm_t *statm)
+{
+    unsigned long  fields[7];
+    char           buf[128];
+    char          *p;
+    char          *end;
+    ssize_t        n;
+
+    if ((n = pread(fd, buf, sizeof(buf) - 1, 0)) <= 0)
+    {
+        return -1;
+    }
+    buf[n] = '\0';
+
+    p = buf;
+    for (int i = 0; i < 7; i++)
+    {
+        fields[i] = strtoul(p, &end, 10);
+        if (end == p)
+        {
+            return -1;
+        }
+        p = end;
+    }
+
+    statm->size     = fields[0];
+    statm->resident = fields[1];
+    statm->shared   = fields[2];
+    statm->text     = fields[3];
+    statm->lib      = fields[4];
+    statm->data     = fields[5];
+    statm->dt       = fields[6];
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Opens /proc/[pid]/smaps_rollup so that it can be sampled repeatedly.
+//
+// @param pid process whose memory usage will be sampled.
+// @return On success, returns a file descriptor. Otherwise, returns -1.
+//-----------------------------------------------------------------------------
+int open_smaps_rollup(pid_t pid)
+{
+    char filepath[40];
+    sprintf(filepath, "/proc/%d/smaps_rollup", (int) pid);
+    return open(filepath, O_RDONLY | O_CLOEXEC);
+}
+
+//-----------------------------------------------------------------------------
+// Parses the value of a "Key:   1234 kB" line, starting just after the key.
+//-----------------------------------------------------------------------------
+static unsigned long parse_kb(const char *p, const char *end)
+{
+    unsigned long value = 0;
+
+    while ((p < end) && (*p == ' '))
+        p++;
+
+    while ((p < end) && (*p >= '0') && (*p <= '9'))
+        value = value * 10 + (unsigned long) (*p++ - '0');
+
+    return value;
+}
+
+//-----------------------------------------------------------------------------
+// Reads and parses /proc/[pid]/smaps_rollup through a file descriptor
+// returned by open_smaps_rollup. The file is scanned in place: each line's
+// key is compared with memcmp, including the colon so that e.g. "Pss:" does
+// not match "Pss_Anon:", and only the wanted values are converted.
+//
+// @param fd file descriptor returned by open_smaps_rollup.
+// @param rollup on success, will be updated with the current memory usage of the process.
+// @return If the file is parsed successfully, return 0. Otherwise, returns -1.
+//-----------------------------------------------------------------------------
+int read_smaps_rollup(int fd, struct smaps_rollup_t *rollup)
+{
+    char           buf[2048];
+    const char    *p;
+    const char    *end;
+    const char    *eol;
+    ssize_t        n;
+    int            found = 0;
+
+    if ((n = pread(fd, buf, sizeof(buf), 0)) <= 0)
+    {
+        return -1;
+    }
+
+    rollup->rss       = 0;
+    rollup->pss       = 0;
+    rollup->anonymous = 0;
+    rollup->swap      = 0;
+
+    // The first line describes the address range covered by the rollup.
+    end = buf + n;
+    if ((p = memchr(buf, '\n', n)) == NULL)
+    {
+        return -1;
+    }
+
+    for (p++; (p < end) && (found < 4); p = eol + 1)
+    {
+        if ((eol = memchr(p, '\n', end - p)) == NULL)
+        {
+            eol = end;
+        }
+
+        if ((eol - p > 4) && (memcmp(p, "Rss:", 4) == 0))
+        {
+            rollup->rss = parse_kb(p + 4, eol);
+            found++;
+        }
+        else if ((eol - p > 4) && (memcmp(p, "Pss:", 4) == 0))
+        {
+            rollup->pss = parse_kb(p + 4, eol);
+            found++;
+        }
+        else if ((eol - p > 10) && (memcmp(p, "Anonymous:", 10) == 0))
+        {
+            rollup->anonymous = parse_kb(p + 10, eol);
+            found++;
+        }
+        else if ((eol - p > 5) && (memcmp(p, "Swap:", 5) == 0))
+        {
+            rollup->swap = parse_kb(p + 5, eol);
+            found++;
+        }
+    }
+
+    // Every kernel that has smaps_rollup reports at least Rss and Pss.
+    return (found >= 2) ? 0 : -1;
+}
@@ -0,0 +1,1069 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../include/pipeline.h"
+#include "../include/queue.h"
+#include "../include/registry.h"
+#include "../include/mem_sampler.h"
+#include "../include/arena.h"
+#include "../include/history.h"
+
+//-----------------------------------------------------------------------------
+// Size of a cache line. Per-thread state is aligned to it so threads don't
+// invalidate each other's counters.
+//-----------------------------------------------------------------------------
+#define CACHE_LINE_SIZE (64)
+
+//-----------------------------------------------------------------------------
+// Number of exited processes classified together with one classify_batch.
+//-----------------------------------------------------------------------------
+#define SCORE_BATCH_SIZE (1024)
+
+//-----------------------------------------------------------------------------
+// Time an idle classifier or writer waits before polling its queue again.
+//-----------------------------------------------------------------------------
+#define IDLE_SLEEP_US (200)
+
+//-----------------------------------------------------------------------------
+// Smallest hash table a sampler starts with.
+//-----------------------------------------------------------------------------
+#define MIN_TABLE_BUCKETS (16)
+
+//-----------------------------------------------------------------------------
+// Kinds of process events queued to the sampler that owns the process.
+//-----------------------------------------------------------------------------
+#define EVENT_SUBMIT (0)
+#define EVENT_EXEC   (1)
+#define EVENT_FINISH (2)
+
+//-----------------------------------------------------------------------------
+// Items passed between the stages.
+//-----------------------------------------------------------------------------
+struct event_t
+{
+    int                  kind;     // one of EVENT_*
+    pid_t                pid;
+    int                  slot;     // workload of the process (submit, exec)
+    struct mem_sampler_t sampler;  // open /proc/[pid] files (submit)
+    struct sample_rate_t rate;     // sampling rate after the first sample (submit)
+    long                 due_us;   // time of the next sample (submit)
+    unsigned long        peak;     // first sample (submit)
+    unsigned long        peak_pss; // first sample (submit)
+};
+
+struct exited_t
+{
+    pid_t         pid;
+    int           slot;
+    unsigned long peak;
+    unsigned long peak_pss;
+};
+
+struct result_t
+{
+    pid_t         pid;
+    int           slot;
+    unsigned long peak;
+    unsigned long peak_pss;
+    int           prediction;
+    int           training; // set if the process trained its workload instead of being classified
+};
+
+//-----------------------------------------------------------------------------
+// A process tracked by a sampler.
+//-----------------------------------------------------------------------------
+struct entry_t
+{
+    pid_t                pid;      // process id, 0 if the bucket is empty
+    int                  slot;     // registry slot of the process' workload, -1 if none
+    int                  dead;     // set once the process has been found to have exited
+    struct mem_sampler_t sampler;  // open /proc/[pid] files
+    struct sample_rate_t rate;     // adaptive sampling rate of the process
+    long                 due_us;   // time of the next sample, LONG_MAX once the budget is used up
+    unsigned long        peak;     // peak data + stack pages seen so far
+    unsigned long        peak_pss; // peak PSS in kB seen so far, 0 if smaps_rollup was never read
+};
+
+//-----------------------------------------------------------------------------
+// A sampler thread and the partition of processes it owns: those whose pid
+// modulo the number of samplers is its id. The partition is an open
+// addressing hash table keyed by pid, so events can find their process.
+//
+// Only the owner adds and removes entries, and only between the two round
+// barriers when no other thread is sampling. During a round any thread may
+// claim chunks of buckets by advancing cursor.
+//-----------------------------------------------------------------------------
+struct sampler_t
+{
+    struct pipeline_data_t *data;
+    size_t                  id;
+    pthread_t               thread;
+    struct queue_t         *inbox;    // events of the processes in the partition
+
+    struct entry_t         *table;
+    size_t                  mask;     // number of buckets minus one
+    size_t                  count;    // number of entries in the table
+    size_t                  num_dead; // entries found to have exited this round
+    size_t                  cursor;
+
+    unsigned long           reads;
+    unsigned long           rollup_reads;
+    unsigned long           steals;
+    unsigned long           exits;
+    unsigned long           stalls;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+//-----------------------------------------------------------------------------
+// Private data members of pipeline_t object.
+//-----------------------------------------------------------------------------
+struct pipeline_data_t
+{
+    struct registry_t        *registry;
+    struct pipeline_config_t  config;
+    FILE                     *out;
+
+    struct queue_t           *exited;
+    struct queue_t           *results;
+
+    struct sampler_t         *samplers;
+    pthread_barrier_t         round_start;
+    pthread_barrier_t         round_ready;
+    pthread_mutex_t           start_lock;
+    pthread_cond_t            start_cond;
+    int                       start_state;     // 0 until every thread is started, then 1, or -1 to abort
+    pthread_t                 classifier_thread;
+    pthread_t                 writer_thread;
+
+    // Training samples of workloads without a model, indexed by slot. Only
+    // the classifier stage uses them.
+    struct arena_t           *train_arena;
+    struct sample_buf_t      *train_bufs;
+
+    int                       stopped;         // set once stop has joined the stages
+    int                       stop;            // tells the samplers to finish
+    int                       round_stop;      // stop as seen by sampler 0 before a round
+    int                       samplers_done;   // no more exited processes will be queued
+    int                       classifier_done; // no more results will be queued
+
+    unsigned long             tracked;
+    unsigned long             max_tracked;
+    unsigned long             submitted;
+    unsigned long             rejected;
+    unsigned long             reads;           // first samples taken by submit
+    unsigned long             rollup_reads;
+    unsigned long             rounds;
+    unsigned long             stalls;
+    unsigned long             trained;
+    unsigned long             scored;
+    unsigned long             anomalies;
+};
+
+//-----------------------------------------------------------------------------
+// The pipeline object and its private data live in a single allocation.
+//-----------------------------------------------------------------------------
+struct pipeline_block_t
+{
+    struct pipeline_t      pipeline;
+    struct pipeline_data_t data;
+};
+
+//-----------------------------------------------------------------------------
+// Returns the current monotonic time in microseconds.
+//-----------------------------------------------------------------------------
+static long now_us(void)
+{
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return tp.tv_sec * 1000000 + tp.tv_nsec / 1000;
+}
+
+//-----------------------------------------------------------------------------
+// Returns when a process sampled at now_us should be sampled next.
+//-----------------------------------------------------------------------------
+static long next_due(struct sample_rate_t *rate, unsigned long value, long now_us)
+{
+    long interval = next_sample_interval(rate, value);
+
+    return interval < 0 ? LONG_MAX : now_us + interval;
+}
+
+//-----------------------------------------------------------------------------
+// Pushes an item, waiting for the next stage to make room if the queue is
+// full. Every wait is counted as a stall.
+//-----------------------------------------------------------------------------
+static void push_wait(struct queue_t *queue, const void *item, unsigned long *stalls)
+{
+    while (queue->push(queue, item) == -1)
+    {
+        __atomic_add_fetch(stalls, 1, __ATOMIC_RELAXED);
+        usleep(IDLE_SLEEP_US);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Returns the sampler that owns a process.
+//-----------------------------------------------------------------------------
+static struct sampler_t *owner_of(struct pipeline_data_t *data, pid_t pid)
+{
+    return &data->samplers[(size_t) pid % data->config.num_samplers];
+}
+
+//-----------------------------------------------------------------------------
+// Home bucket of a pid in its owner's table. The pids of a partition are all
+// congruent modulo the number of samplers, so divide that out first to
+// spread them over every bucket.
+//-----------------------------------------------------------------------------
+static size_t home_bucket(struct sampler_t *self, pid_t pid)
+{
+    return ((size_t) pid / self->data->config.num_samplers) & self->mask;
+}
+
+//-----------------------------------------------------------------------------
+// Finds the entry of a process in a sampler's table.
+//
+// @return the entry, or NULL if the process is not tracked.
+//-----------------------------------------------------------------------------
+static struct entry_t *find_entry(struct sampler_t *self, pid_t pid)
+{
+    size_t h = home_bucket(self, pid);
+
+    while (self->table[h].pid != 0)
+    {
+        if (self->table[h].pid == pid)
+            return &self->table[h];
+        h = (h + 1) & self->mask;
+    }
+
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Stops tracking a process. Entries following it in the same probe run are
+// shifted back so that lookups never need tombstones.
+//-----------------------------------------------------------------------------
+static void remove_entry(struct sampler_t *self, struct entry_t *entry)
+{
+    size_t hole = entry - self->table;
+    size_t h    = hole;
+    size_t home;
+
+    close_mem_sampler(&entry->sampler);
+
+    for (;;)
+    {
+        h = (h + 1) & self->mask;
+        if (self->table[h].pid == 0)
+            break;
+
+        // Move the entry into the hole unless its home bucket lies in the
+        // cyclic range (hole, h], in which case it is already reachable.
+        home = home_bucket(self, self->table[h].pid);
+        if (((h - home) & self->mask) >= ((h - hole) & self->mask))
+        {
+            self->table[hole] = self->table[h];
+            hole = h;
+        }
+    }
+
+    self->table[hole].pid = 0;
+    self->count--;
+    __atomic_sub_fetch(&self->data->tracked, 1, __ATOMIC_RELAXED);
+}
+
+//-----------------------------------------------------------------------------
+// Places an entry in the first free bucket of its probe run. The table must
+// have a free bucket.
+//-----------------------------------------------------------------------------
+static struct entry_t *place_entry(struct sampler_t *self, pid_t pid)
+{
+    size_t h;
+
+    for (h = home_bucket(self, pid); self->table[h].pid != 0; h = (h + 1) & self->mask)
+        ;
+
+    return &self->table[h];
+}
+
+//-----------------------------------------------------------------------------
+// Doubles the number of buckets of a sampler's table.
+//
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+static int grow_table(struct sampler_t *self)
+{
+    struct entry_t *old      = self->table;
+    size_t          old_mask = self->mask;
+
+    if ((self->table = (struct entry_t *) calloc(2 * (old_mask + 1), sizeof(struct entry_t))) == NULL)
+    {
+        self->table = old;
+        return -1;
+    }
+
+    self->mask = 2 * (old_mask + 1) - 1;
+
+    for (size_t h = 0; h <= old_mask; h++)
+    {
+        if (old[h].pid != 0)
+            *place_entry(self, old[h].pid) = old[h];
+    }
+
+    free(old);
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Takes one sample of a process and updates its peaks.
+//
+// @param self the sampler taking the sample, which is charged for the read.
+// @param now_us the current time, from which the next sample is scheduled.
+// @return If the process could be sampled, returns 0. Otherwise, returns -1.
+//-----------------------------------------------------------------------------
+static int sample_entry(struct sampler_t *self, struct entry_t *entry, long now_us)
+{
+    struct mem_sample_t sample;
+
+    self->reads++;
+    if (mem_sampler_read(&entry->sampler, entry->pid, &sample) == -1)
+        return -1;
+
+    if (entry->peak < sample.statm.data)
+        entry->peak = sample.statm.data;
+    entry->due_us = next_due(&entry->rate, sample.statm.data, now_us);
+
+    if (sample.has_rollup)
+    {
+        self->rollup_reads++;
+        if (entry->peak_pss < sample.rollup.pss)
+            entry->peak_pss = sample.rollup.pss;
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Marks a process as exited and hands its peaks to the classifier.
+//-----------------------------------------------------------------------------
+static void exit_entry(struct sampler_t *self, struct entry_t *entry)
+{
+    struct exited_t exited;
+
+    entry->dead       = 1;
+    exited.pid        = entry->pid;
+    exited.slot       = entry->slot;
+    exited.peak       = entry->peak;
+    exited.peak_pss   = entry->peak_pss;
+    self->exits++;
+    push_wait(self->data->exited, &exited, &self->stalls);
+}
+
+//-----------------------------------------------------------------------------
+// Applies an event to the sampler's partition.
+//-----------------------------------------------------------------------------
+static void apply_event(struct sampler_t *self, struct event_t *event)
+{
+    struct pipeline_data_t *data  = self->data;
+    struct entry_t         *entry = find_entry(self, event->pid);
+
+    switch (event->kind)
+    {
+    case EVENT_SUBMIT:
+        // The pid is still tracked if the old process' exit was lost. Hand
+        // its peak on before the entry is reused, or it never reaches the
+        // history.
+        if (entry != NULL)
+        {
+            if (!entry->dead)
+                exit_entry(self, entry);
+            remove_entry(self, entry);
+        }
+
+        // Keep the table at most half full.
+        if ((2 * (self->count + 1) > self->mask + 1) && (grow_table(self) == -1))
+        {
+            close_mem_sampler(&event->sampler);
+            __atomic_sub_fetch(&data->tracked, 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&data->rejected, 1, __ATOMIC_RELAXED);
+            break;
+        }
+
+        entry           = place_entry(self, event->pid);
+        entry->pid      = event->pid;
+        entry->slot     = event->slot;
+        entry->dead     = 0;
+        entry->sampler  = event->sampler;
+        entry->rate     = event->rate;
+        entry->due_us   = event->due_us;
+        entry->peak     = event->peak;
+        entry->peak_pss = event->peak_pss;
+        self->count++;
+        break;
+
+    case EVENT_EXEC:
+        // A new program is a new workload; start its peak from scratch.
+        if ((entry != NULL) && !entry->dead)
+        {
+            entry->slot     = event->slot;
+            entry->peak     = 0;
+            entry->peak_pss = 0;
+            reset_mem_sampler_rollup(&entry->sampler);
+            init_sample_rate(&entry->rate, &self->data->config.sample_rate);
+            sample_entry(self, entry, now_us());
+        }
+        break;
+
+    case EVENT_FINISH:
+        if (entry != NULL)
+        {
+            if (!entry->dead)
+                exit_entry(self, entry);
+            remove_entry(self, entry);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Prepares a sampler's partition for the next round: drops the processes that
+// were found to have exited during the last round and applies the events
+// queued since. At most queue_size events are applied per round so that a
+// flood of events can't hold up sampling.
+//-----------------------------------------------------------------------------
+static void prepare_partition(struct sampler_t *self)
+{
+    struct event_t event;
+
+    if (self->num_dead > 0)
+    {
+        // Removing an entry can shift the next one into this bucket, so
+        // check the same bucket again after a removal.
+        for (size_t h = 0; h <= self->mask; h++)
+        {
+            while ((self->table[h].pid != 0) && self->table[h].dead)
+                remove_entry(self, &self->table[h]);
+        }
+        self->num_dead = 0;
+    }
+
+    for (size_t i = 0; (i < self->data->config.queue_size) && (self->inbox->pop(self->inbox, &event) == 0); i++)
+        apply_event(self, &event);
+
+    self->cursor = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Samples chunks of a partition until all of them have been claimed. The
+// partition is either the sampler's own or one it is stealing from.
+//-----------------------------------------------------------------------------
+static void sample_partition(struct sampler_t *self, struct sampler_t *partition)
+{
+    size_t          chunk = self->data->config.chunk_size;
+    size_t          start;
+    size_t          end;
+    long            now;
+    struct entry_t *entry;
+
+    if (partition->count == 0)
+        return;
+
+    while ((start = __atomic_fetch_add(&partition->cursor, chunk, __ATOMIC_RELAXED)) <= partition->mask)
+    {
+        end = start + chunk <= partition->mask ? start + chunk : partition->mask + 1;
+
+        if (partition != self)
+            self->steals++;
+
+        now = now_us();
+        for (size_t h = start; h < end; h++)
+        {
+            entry = &partition->table[h];
+
+            // Processes whose memory has been flat for a while are only
+            // sampled once their backed off interval has passed.
+            if ((entry->pid == 0) || entry->dead || (entry->due_us > now))
+                continue;
+
+            // The process is gone; hand its peak to the classifier.
+            if (sample_entry(self, entry, now) == -1)
+            {
+                exit_entry(self, entry);
+                __atomic_add_fetch(&partition->num_dead, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Sampler stage. Rounds are delimited by two barriers: after round_start
+// every sampler prepares its own partition, and after round_ready all of
+// them sample, starting with their own partition and then stealing from the
+// others. Sampler 0 starts a round every min_interval_us, the shortest time
+// any process waits between two samples. No sampler enters the barriers
+// before create_pipeline has started all of them.
+//-----------------------------------------------------------------------------
+static void *sampler_main(void *arg)
+{
+    struct sampler_t       *self = (struct sampler_t *) arg;
+    struct pipeline_data_t *data = self->data;
+    size_t                  n    = data->config.num_samplers;
+    long                    next_round = now_us();
+    long                    now;
+    int                     start;
+
+    pthread_mutex_lock(&data->start_lock);
+    while ((start = data->start_state) == 0)
+        pthread_cond_wait(&data->start_cond, &data->start_lock);
+    pthread_mutex_unlock(&data->start_lock);
+
+    if (start == -1)
+        return NULL;
+
+    for (;;)
+    {
+        if (self->id == 0)
+        {
+            if ((now = now_us()) < next_round)
+                usleep(next_round - now);
+            next_round = now_us() + data->config.sample_rate.min_interval_us;
+            data->round_stop = __atomic_load_n(&data->stop, __ATOMIC_ACQUIRE);
+        }
+
+        pthread_barrier_wait(&data->round_start);
+        if (data->round_stop)
+            break;
+
+        prepare_partition(self);
+        pthread_barrier_wait(&data->round_ready);
+
+        for (size_t k = 0; k < n; k++)
+            sample_partition(self, &data->samplers[(self->id + k) % n]);
+
+        if (self->id == 0)
+            __atomic_add_fetch(&data->rounds, 1, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Uses an exited process to train its workload if the workload has no model
+// yet. The workload is trained once train_samples processes have exited.
+//
+// @return 1 if the process was used for training (or dropped because its
+// samples could not be stored), 0 if it should be classified.
+//-----------------------------------------------------------------------------
+static int train_exited(struct pipeline_data_t *data, const struct exited_t *exited)
+{
+    struct sample_buf_t *buf;
+    struct result_t      result;
+
+    if ((data->train_bufs == NULL) || data->registry->is_trained(data->registry, exited->slot))
+        return 0;
+
+    buf = &data->train_bufs[exited->slot];
+
+    if (((buf->samples == NULL) && (init_sample_buf(buf, data->train_arena, data->config.train_samples) == -1)) ||
+        (sample_buf_push(buf, exited->peak) == -1))
+        return 1;
+
+    result.pid        = exited->pid;
+    result.slot       = exited->slot;
+    result.peak       = exited->peak;
+    result.peak_pss   = exited->peak_pss;
+    result.prediction = 1;
+    result.training   = 1;
+    push_wait(data->results, &result, &data->stalls);
+    __atomic_add_fetch(&data->trained, 1, __ATOMIC_RELAXED);
+
+    if (buf->len == data->config.train_samples)
+        data->registry->train(data->registry, exited->slot, buf->samples, buf->len);
+
+    return 1;
+}
+
+//-----------------------------------------------------------------------------
+// Classifier stage. Scores exited processes in batches. Processes without a
+// workload or without a single sample are skipped.
+//-----------------------------------------------------------------------------
+static void *classifier_main(void *arg)
+{
+    struct pipeline_data_t *data = (struct pipeline_data_t *) arg;
+    struct exited_t         exited;
+    struct result_t         result;
+    struct exited_t         batch[SCORE_BATCH_SIZE];
+    int                     slots[SCORE_BATCH_SIZE];
+    double                  samples[SCORE_BATCH_SIZE];
+    int                     predictions[SCORE_BATCH_SIZE];
+    size_t                  popped;
+    size_t                  n;
+    int                     done;
+
+    for (;;)
+    {
+        // Read the flag before popping, so that an empty queue seen after
+        // the samplers are done really is the end of the stream.
+        done = __atomic_load_n(&data->samplers_done, __ATOMIC_ACQUIRE);
+
+        for (popped = 0, n = 0; (n < SCORE_BATCH_SIZE) && (data->exited->pop(data->exited, &exited) == 0); popped++)
+        {
+            if ((exited.slot == -1) || (exited.peak == 0) || train_exited(data, &exited))
+                continue;
+
+            batch[n]   = exited;
+            slots[n]   = exited.slot;
+            samples[n] = exited.peak;
+            n++;
+        }
+
+        if (popped == 0)
+        {
+            if (done)
+                break;
+            usleep(IDLE_SLEEP_US);
+            continue;
+        }
+
+        data->registry->classify_batch(data->registry, slots, samples, predictions, n);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            result.pid        = batch[i].pid;
+            result.slot       = batch[i].slot;
+            result.peak       = batch[i].peak;
+            result.peak_pss   = batch[i].peak_pss;
+            result.prediction = predictions[i];
+            result.training   = 0;
+            push_wait(data->results, &result, &data->stalls);
+        }
+    }
+
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Writer stage. Records every exited process in the history store and
+// writes one line per anomaly.
+//-----------------------------------------------------------------------------
+static void *writer_main(void *arg)
+{
+    struct pipeline_data_t  *data = (struct pipeline_data_t *) arg;
+    struct history_t        *history = data->config.history;
+    struct result_t          result;
+    struct history_record_t  record;
+    const char              *key;
+    int                      done;
+
+    for (;;)
+    {
+        done = __atomic_load_n(&data->classifier_done, __ATOMIC_ACQUIRE);
+
+        if (data->results->pop(data->results, &result) == -1)
+        {
+            if (done)
+                break;
+            if (data->out != NULL)
+                fflush(data->out);
+            usleep(IDLE_SLEEP_US);
+            continue;
+        }
+
+        key = data->registry->get_key(data->registry, result.slot);
+
+        if (history != NULL)
+        {
+            record.timestamp  = history_now();
+            record.pid        = result.pid;
+            record.workload   = history_workload_id(key);
+            record.peak       = result.peak;
+            record.prediction = result.prediction;
+            record.training   = result.training;
+            history->append(history, &record);
+        }
+
+        if (result.training)
+            continue;
+
+        __atomic_add_fetch(&data->scored, 1, __ATOMIC_RELAXED);
+
+        if (result.prediction == 0)
+        {
+            __atomic_add_fetch(&data->anomalies, 1, __ATOMIC_RELAXED);
+            if (data->out != NULL)
+                fprintf(data->out, "%d %s %lu %lu\n", (int) result.pid, key, result.peak, result.peak_pss);
+        }
+    }
+
+    if (data->out != NULL)
+        fflush(data->out);
+
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Raises a maximum counter to value if it is larger.
+//-----------------------------------------------------------------------------
+static void update_max(unsigned long *max, unsigned long value)
+{
+    unsigned long current = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+    while ((value > current) &&
+        !__atomic_compare_exchange_n(max, &current, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+//-----------------------------------------------------------------------------
+// Start monitoring a new process. Its files are opened and it is sampled
+// right away, since it may be gone before its owner's next round.
+//
+// @param pipeline the pipeline object.
+// @param pid the process to monitor.
+// @param slot the registry slot of the process' workload, or -1 if it has none.
+// @return On success, returns 0. If the process can't be tracked, returns -1.
+//-----------------------------------------------------------------------------
+static int submit(struct pipeline_t *pipeline, pid_t pid, int slot)
+{
+    struct pipeline_data_t *data  = pipeline->data;
+    struct sampler_t       *owner = owner_of(data, pid);
+    struct event_t          event = { .kind = EVENT_SUBMIT, .pid = pid, .slot = slot };
+    struct mem_sample_t     sample;
+    unsigned long           tracked;
+    long                    now;
+
+    if ((tracked = __atomic_add_fetch(&data->tracked, 1, __ATOMIC_RELAXED)) > data->config.max_tracked)
+    {
+        __atomic_sub_fetch(&data->tracked, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&data->rejected, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    // The process may already be gone by the time it is submitted.
+    if (open_mem_sampler(&event.sampler, pid, data->config.rollup_thresh_pages) == -1)
+    {
+        __atomic_sub_fetch(&data->tracked, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    __atomic_add_fetch(&data->reads, 1, __ATOMIC_RELAXED);
+    now = now_us();
+    if (mem_sampler_read(&event.sampler, pid, &sample) == -1)
+    {
+        close_mem_sampler(&event.sampler);
+        __atomic_sub_fetch(&data->tracked, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    event.peak     = sample.statm.data;
+    event.peak_pss = sample.has_rollup ? sample.rollup.pss : 0;
+    init_sample_rate(&event.rate, &data->config.sample_rate);
+    event.due_us   = next_due(&event.rate, sample.statm.data, now);
+    if (sample.has_rollup)
+        __atomic_add_fetch(&data->rollup_reads, 1, __ATOMIC_RELAXED);
+
+    if (owner->inbox->push(owner->inbox, &event) == -1)
+    {
+        close_mem_sampler(&event.sampler);
+        __atomic_sub_fetch(&data->tracked, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&data->rejected, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    __atomic_add_fetch(&data->submitted, 1, __ATOMIC_RELAXED);
+    update_max(&data->max_tracked, tracked);
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Report that a monitored process replaced its program.
+//-----------------------------------------------------------------------------
+static void exec(struct pipeline_t *pipeline, pid_t pid, int slot)
+{
+    struct event_t event = { .kind = EVENT_EXEC, .pid = pid, .slot = slot };
+
+    push_wait(owner_of(pipeline->data, pid)->inbox, &event, &pipeline->data->stalls);
+}
+
+//-----------------------------------------------------------------------------
+// Report that a monitored process has exited.
+//-----------------------------------------------------------------------------
+static void finish(struct pipeline_t *pipeline, pid_t pid)
+{
+    struct event_t event = { .kind = EVENT_FINISH, .pid = pid };
+
+    push_wait(owner_of(pipeline->data, pid)->inbox, &event, &pipeline->data->stalls);
+}
+
+//-----------------------------------------------------------------------------
+// Get a snapshot of the pipeline counters. The per-sampler counters are read
+// without synchronization, so they may lag slightly behind while running.
+//-----------------------------------------------------------------------------
+static void get_stats(struct pipeline_t *pipeline, struct pipeline_stats_t *stats)
+{
+    struct pipeline_data_t *data = pipeline->data;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->submitted    = __atomic_load_n(&data->submitted, __ATOMIC_RELAXED);
+    stats->rejected     = __atomic_load_n(&data->rejected, __ATOMIC_RELAXED);
+    stats->rounds       = __atomic_load_n(&data->rounds, __ATOMIC_RELAXED);
+    stats->reads        = __atomic_load_n(&data->reads, __ATOMIC_RELAXED);
+    stats->rollup_reads = __atomic_load_n(&data->rollup_reads, __ATOMIC_RELAXED);
+    stats->stalls       = __atomic_load_n(&data->stalls, __ATOMIC_RELAXED);
+    stats->trained      = __atomic_load_n(&data->trained, __ATOMIC_RELAXED);
+    stats->scored       = __atomic_load_n(&data->scored, __ATOMIC_RELAXED);
+    stats->anomalies    = __atomic_load_n(&data->anomalies, __ATOMIC_RELAXED);
+    stats->tracked      = __atomic_load_n(&data->tracked, __ATOMIC_RELAXED);
+    stats->max_tracked  = __atomic_load_n(&data->max_tracked, __ATOMIC_RELAXED);
+
+    for (size_t i = 0; i < data->config.num_samplers; i++)
+    {
+        stats->reads        += __atomic_load_n(&data->samplers[i].reads, __ATOMIC_RELAXED);
+        stats->rollup_reads += __atomic_load_n(&data->samplers[i].rollup_reads, __ATOMIC_RELAXED);
+        stats->steals       += __atomic_load_n(&data->samplers[i].steals, __ATOMIC_RELAXED);
+        stats->exits        += __atomic_load_n(&data->samplers[i].exits, __ATOMIC_RELAXED);
+        stats->stalls       += __atomic_load_n(&data->samplers[i].stalls, __ATOMIC_RELAXED);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Stop the pipeline and wait for it to drain. The stages are shut down front
+// to back so everything already queued is written out.
+//-----------------------------------------------------------------------------
+static void stop(struct pipeline_t *pipeline)
+{
+    struct pipeline_data_t *data = pipeline->data;
+
+    if (data->stopped)
+        return;
+    data->stopped = 1;
+
+    __atomic_store_n(&data->stop, 1, __ATOMIC_RELEASE);
+    for (size_t i = 0; i < data->config.num_samplers; i++)
+        pthread_join(data->samplers[i].thread, NULL);
+
+    __atomic_store_n(&data->samplers_done, 1, __ATOMIC_RELEASE);
+    pthread_join(data->classifier_thread, NULL);
+
+    __atomic_store_n(&data->classifier_done, 1, __ATOMIC_RELEASE);
+    pthread_join(data->writer_thread, NULL);
+}
+
+//-----------------------------------------------------------------------------
+// Closes the processes still tracked or waiting in an inbox and frees the
+// pipeline's memory. Must only be called once no stage is running.
+//-----------------------------------------------------------------------------
+static void release(struct pipeline_data_t *data)
+{
+    struct event_t event;
+
+    for (size_t i = 0; (data->samplers != NULL) && (i < data->config.num_samplers); i++)
+    {
+        for (size_t h = 0; (data->samplers[i].table != NULL) && (h <= data->samplers[i].mask); h++)
+        {
+            if (data->samplers[i].table[h].pid != 0)
+                close_mem_sampler(&data->samplers[i].table[h].sampler);
+        }
+
+        while ((data->samplers[i].inbox != NULL) && (data->samplers[i].inbox->pop(data->samplers[i].inbox, &event) == 0))
+        {
+            if (event.kind == EVENT_SUBMIT)
+                close_mem_sampler(&event.sampler);
+        }
+
+        free(data->samplers[i].table);
+        delete_queue(data->samplers[i].inbox);
+    }
+
+    delete_queue(data->exited);
+    delete_queue(data->results);
+    delete_arena(data->train_arena);
+    free(data->samplers);
+}
+
+//-----------------------------------------------------------------------------
+// Lets the started samplers run, or tells them to return if abort is set.
+//-----------------------------------------------------------------------------
+static void release_samplers(struct pipeline_data_t *data, int abort)
+{
+    pthread_mutex_lock(&data->start_lock);
+    data->start_state = abort ? -1 : 1;
+    pthread_cond_broadcast(&data->start_cond);
+    pthread_mutex_unlock(&data->start_lock);
+}
+
+//-----------------------------------------------------------------------------
+// Joins the threads that were started before one failed to start. The
+// samplers are still held at the start gate, so none of them has entered a
+// round and the stages have nothing to drain.
+//-----------------------------------------------------------------------------
+static void abort_start(struct pipeline_data_t *data, size_t samplers, int classifier, int writer)
+{
+    release_samplers(data, 1);
+    for (size_t i = 0; i < samplers; i++)
+        pthread_join(data->samplers[i].thread, NULL);
+
+    __atomic_store_n(&data->samplers_done, 1, __ATOMIC_RELEASE);
+    if (classifier)
+        pthread_join(data->classifier_thread, NULL);
+
+    __atomic_store_n(&data->classifier_done, 1, __ATOMIC_RELEASE);
+    if (writer)
+        pthread_join(data->writer_thread, NULL);
+}
+
+//-----------------------------------------------------------------------------
+// Create a new pipeline object and start its threads.
+//
+// @param registry the registry used to classify exited processes.
+// @param config settings for the pipeline.
+// @param out where the writer stage writes anomalies, or NULL to discard them.
+// @return the pipeline, or NULL if memory could not be allocated or a thread
+// could not be started.
+//-----------------------------------------------------------------------------
+struct pipeline_t *create_pipeline(struct registry_t *registry, const struct pipeline_config_t *config, FILE *out)
+{
+    struct pipeline_block_t *block;
+    struct pipeline_data_t  *data;
+    size_t                   n = config->num_samplers;
+    size_t                   buckets = MIN_TABLE_BUCKETS;
+    size_t                   started = 0;
+    int                      failed = 0;
+
+    if ((n == 0) || (config->chunk_size == 0) || (config->queue_size == 0))
+        return NULL;
+
+    if ((block = (struct pipeline_block_t *) calloc(1, sizeof(struct pipeline_block_t))) == NULL)
+        return NULL;
+
+    data = &block->data;
+    block->pipeline.data = data;
+    data->registry = registry;
+    data->config   = *config;
+    data->out      = out;
+
+    data->exited  = create_queue(config->queue_size, sizeof(struct exited_t));
+    data->results = create_queue(config->queue_size, sizeof(struct result_t));
+
+    if (posix_memalign((void **) &data->samplers, CACHE_LINE_SIZE, n * sizeof(struct sampler_t)) == 0)
+        memset(data->samplers, 0, n * sizeof(struct sampler_t));
+    else
+        data->samplers = NULL;
+
+    // Online training needs a sample buffer per workload.
+    if ((config->train_samples > 0) && (config->max_workloads > 0))
+    {
+        if (((data->train_arena = create_arena(ARENA_DEFAULT_CHUNK_SIZE)) != NULL) &&
+            ((data->train_bufs = (struct sample_buf_t *) data->train_arena->alloc(data->train_arena,
+                config->max_workloads * sizeof(struct sample_buf_t))) != NULL))
+            memset(data->train_bufs, 0, config->max_workloads * sizeof(struct sample_buf_t));
+        else
+            failed = 1;
+    }
+
+    if ((data->exited == NULL) || (data->results == NULL) || (data->samplers == NULL) || failed)
+    {
+        release(data);
+        free(block);
+        return NULL;
+    }
+
+    // Start each table with room for a fair share of the processes, so that
+    // growing is only needed when pids don't spread evenly.
+    while (buckets < 2 * (config->max_tracked / n + 1))
+        buckets *= 2;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        data->samplers[i].data  = data;
+        data->samplers[i].id    = i;
+        data->samplers[i].mask  = buckets - 1;
+        data->samplers[i].table = (struct entry_t *) calloc(buckets, sizeof(struct entry_t));
+        data->samplers[i].inbox = create_queue(config->queue_size, sizeof(struct event_t));
+        failed |= (data->samplers[i].table == NULL) || (data->samplers[i].inbox == NULL);
+    }
+
+    if (failed)
+    {
+        release(data);
+        free(block);
+        return NULL;
+    }
+
+    pthread_barrier_init(&data->round_start, NULL, n);
+    pthread_barrier_init(&data->round_ready, NULL, n);
+    pthread_mutex_init(&data->start_lock, NULL);
+    pthread_cond_init(&data->start_cond, NULL);
+
+    // The samplers wait on each other at every round, so the pipeline can't
+    // run with only some of them. They are held at the start gate until all
+    // threads are up, and the ones already started are joined if one fails.
+    if (pthread_create(&data->classifier_thread, NULL, &classifier_main, data) != 0)
+        failed = 1;
+    else if (pthread_create(&data->writer_thread, NULL, &writer_main, data) != 0)
+    {
+        abort_start(data, 0, 1, 0);
+        failed = 1;
+    }
+    else
+    {
+        while ((started < n) && (pthread_create(&data->samplers[started].thread, NULL, &sampler_main, &data->samplers[started]) == 0))
+            started++;
+
+        if (started < n)
+        {
+            abort_start(data, started, 1, 1);
+            failed = 1;
+        }
+    }
+
+    if (failed)
+    {
+        pthread_barrier_destroy(&data->round_start);
+        pthread_barrier_destroy(&data->round_ready);
+        pthread_mutex_destroy(&data->start_lock);
+        pthread_cond_destroy(&data->start_cond);
+        release(data);
+        free(block);
+        return NULL;
+    }
+
+    release_samplers(data, 0);
+
+    // Attach public methods.
+    block->pipeline.submit    = &submit;
+    block->pipeline.exec      = &exec;
+    block->pipeline.finish    = &finish;
+    block->pipeline.get_stats = &get_stats;
+    block->pipeline.stop      = &stop;
+
+    return &block->pipeline;
+}
+
+//-----------------------------------------------------------------------------
+// Stop the pipeline if it is still running and free up its resources.
+//-----------------------------------------------------------------------------
+void delete_pipeline(struct pipeline_t *pipeline)
+{
+    struct pipeline_data_t *data;
+
+    if (pipeline == NULL)
+        return;
+
+    data = pipeline->data;
+    stop(pipeline);
+
+    pthread_barrier_destroy(&data->round_start);
+    pthread_barrier_destroy(&data->round_ready);
+    pthread_mutex_destroy(&data->start_lock);
+    pthread_cond_destroy(&data->start_cond);
+    release(data);
+
+    // The pipeline is the first member of its block, so this frees the
+    // private data as well.
+    free(pipeline);
+}
@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include "../include/proc_watch.h"
+#include "../include/pipeline.h"
+#include "../include/mem_sampler.h"
+#include "../include/registry.h"
+#include "../include/snapshot.h"
+
+//-----------------------------------------------------------------------------
+// Size of the buffer netlink messages are received into. A single recv can
+// return many proc connector messages.
+//-----------------------------------------------------------------------------
+#define RECV_BUF_SIZE (64 * 1024)
+
+//-----------------------------------------------------------------------------
+// Capacity of each queue between the pipeline stages. Large enough to
+// absorb a burst of process births as big as the socket buffer.
+//-----------------------------------------------------------------------------
+#define QUEUE_SIZE (16384)
+
+//-----------------------------------------------------------------------------
+// Number of table buckets a sampler thread claims at a time.
+//-----------------------------------------------------------------------------
+#define CHUNK_SIZE (64)
+
+//-----------------------------------------------------------------------------
+// State of a watch mode run.
+//-----------------------------------------------------------------------------
+struct watch_t
+{
+    struct watch_stats_t *stats;
+    struct registry_t    *registry;
+    struct pipeline_t    *pipeline;
+};
+
+//-----------------------------------------------------------------------------
+// Set by the signal handler to make run_watch return.
+//-----------------------------------------------------------------------------
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_signal(int sig)
+{
+    stop_requested = 1;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the current monotonic time in milliseconds.
+//-----------------------------------------------------------------------------
+static long now_ms(void)
+{
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return tp.tv_sec * 1000 + tp.tv_nsec / 1000000;
+}
+
+//-----------------------------------------------------------------------------
+// Opens a netlink socket subscribed to the proc connector multicast group.
+//
+// @param rcvbuf_bytes size of the socket receive buffer.
+// @return On success, returns the socket. On error, returns -1.
+//-----------------------------------------------------------------------------
+static int open_proc_connector(int rcvbuf_bytes)
+{
+    struct sockaddr_nl      addr;
+    struct nlmsghdr        *nlh;
+    struct cn_msg          *cn;
+    enum proc_cn_mcast_op   op = PROC_CN_MCAST_LISTEN;
+    char                    msg[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(op))];
+    int                     sock;
+
+    if ((sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR)) == -1)
+        return -1;
+
+    // A large buffer absorbs bursts of process births while we are busy
+    // sampling. SO_RCVBUFFORCE ignores rmem_max but needs CAP_NET_ADMIN,
+    // which we need for the proc connector anyway.
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf_bytes, sizeof(rcvbuf_bytes)) == -1)
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf_bytes, sizeof(rcvbuf_bytes));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    addr.nl_pid    = getpid();
+
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+    {
+        close(sock);
+        return -1;
+    }
+
+    // Ask the kernel to start sending process events.
+    memset(msg, 0, sizeof(msg));
+    nlh = (struct nlmsghdr *) msg;
+    nlh->nlmsg_len  = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+    nlh->nlmsg_type = NLMSG_DONE;
+    nlh->nlmsg_pid  = getpid();
+
+    cn = (struct cn_msg *) NLMSG_DATA(nlh);
+    cn->id.idx = CN_IDX_PROC;
+    cn->id.val = CN_VAL_PROC;
+    cn->len    = sizeof(op);
+    memcpy(cn->data, &op, sizeof(op));
+
+    if (send(sock, nlh, nlh->nlmsg_len, 0) == -1)
+    {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+//-----------------------------------------------------------------------------
+// Reads the command name of a process, which identifies its workload.
+//
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+static int read_workload(pid_t pid, char key[REGISTRY_KEY_LEN])
+{
+    char    filepath[32];
+    ssize_t n;
+    int     fd;
+
+    sprintf(filepath, "/proc/%d/comm", (int) pid);
+    if ((fd = open(filepath, O_RDONLY | O_CLOEXEC)) == -1)
+        return -1;
+
+    n = read(fd, key, REGISTRY_KEY_LEN - 1);
+    close(fd);
+
+    if (n <= 0)
+        return -1;
+
+    // Strip the trailing newline.
+    key[(key[n - 1] == '\n') ? n - 1 : n] = '\0';
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Looks up (or adds) the workload of a process in the registry.
+//
+// @return the registry slot of the workload, or -1 if it can't be read or
+// the registry is full.
+//-----------------------------------------------------------------------------
+static int attach_workload(struct watch_t *watch, pid_t pid)
+{
+    char key[REGISTRY_KEY_LEN];
+
+    return (read_workload(pid, key) == 0) ? watch->registry->add(watch->registry, key) : -1;
+}
+
+//-----------------------------------------------------------------------------
+// Handles a single proc connector event. Only whole processes are tracked,
+// so events about threads other than the main thread are ignored.
+//-----------------------------------------------------------------------------
+static void handle_event(struct watch_t *watch, const struct proc_event *event)
+{
+    pid_t pid;
+
+    watch->stats->events++;
+
+    switch (event->what)
+    {
+    case PROC_EVENT_FORK:
+        if (event->event_data.fork.child_pid != event->event_data.fork.child_tgid)
+            break;
+        watch->stats->forks++;
+        pid = event->event_data.fork.child_tgid;
+        watch->pipeline->submit(watch->pipeline, pid, attach_workload(watch, pid));
+        break;
+
+    case PROC_EVENT_EXEC:
+        watch->stats->execs++;
+        pid = event->event_data.exec.process_tgid;
+        watch->pipeline->exec(watch->pipeline, pid, attach_workload(watch, pid));
+        break;
+
+    case PROC_EVENT_EXIT:
+        if (event->event_data.exit.process_pid != event->event_data.exit.process_tgid)
+            break;
+        watch->stats->exits++;
+        watch->pipeline->finish(watch->pipeline, event->event_data.exit.process_tgid);
+        break;
+
+    default:
+        break;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Receives and handles every event queued on the socket.
+//
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+static int drain_events(struct watch_t *watch, int sock, char *buf)
+{
+    struct nlmsghdr *nlh;
+    struct cn_msg   *cn;
+    ssize_t          n;
+
+    for (;;)
+    {
+        if ((n = recv(sock, buf, RECV_BUF_SIZE, 0)) == -1)
+        {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+                return 0;
+            // The kernel dropped events because the receive buffer was
+            // full. Count it and keep going; exits we missed are caught by
+            // the samplers once the process can no longer be read.
+            if (errno == ENOBUFS)
+            {
+                watch->stats->overruns++;
+                continue;
+            }
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        for (nlh = (struct nlmsghdr *) buf; NLMSG_OK(nlh, n); nlh = NLMSG_NEXT(nlh, n))
+        {
+            if ((nlh->nlmsg_type == NLMSG_NOOP) || (nlh->nlmsg_type == NLMSG_ERROR))
+                continue;
+
+            cn = (struct cn_msg *) NLMSG_DATA(nlh);
+            if ((cn->id.idx != CN_IDX_PROC) || (cn->id.val != CN_VAL_PROC))
+                continue;
+
+            handle_event(watch, (const struct proc_event *) cn->data);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Copies the counters kept by the pipeline into the watch stats.
+//-----------------------------------------------------------------------------
+static void update_stats(struct watch_t *watch)
+{
+    struct pipeline_stats_t pipeline_stats;
+
+    watch->pipeline->get_stats(watch->pipeline, &pipeline_stats);
+    watch->stats->rejected     = pipeline_stats.rejected;
+    watch->stats->reads        = pipeline_stats.reads;
+    watch->stats->rollup_reads = pipeline_stats.rollup_reads;
+    watch->stats->steals       = pipeline_stats.steals;
+    watch->stats->stalls       = pipeline_stats.stalls;
+    watch->stats->trained      = pipeline_stats.trained;
+    watch->stats->scored       = pipeline_stats.scored;
+    watch->stats->anomalies    = pipeline_stats.anomalies;
+    watch->stats->tracked      = pipeline_stats.tracked;
+    watch->stats->max_tracked  = pipeline_stats.max_tracked;
+}
+
+//-----------------------------------------------------------------------------
+// Print watch mode counters to stderr.
+//-----------------------------------------------------------------------------
+void print_watch_stats(const struct watch_stats_t *stats)
+{
+    fprintf(stderr,
+        "events=%lu forks=%lu execs=%lu exits=%lu overruns=%lu rejected=%lu "
+        "reads=%lu rollup_reads=%lu steals=%lu stalls=%lu trained=%lu scored=%lu anomalies=%lu "
+        "tracked=%lu max_tracked=%lu\n",
+        stats->events, stats->forks, stats->execs, stats->exits, stats->overruns, stats->rejected,
+        stats->reads, stats->rollup_reads, stats->steals, stats->stalls, stats->trained, stats->scored,
+        stats->anomalies, stats->tracked, stats->max_tracked);
+}
+
+//-----------------------------------------------------------------------------
+// Watch every process on the host using the kernel proc connector.
+//
+// @param registry the registry of per-workload classifiers.
+// @param config settings for watch mode.
+// @param stats on return, the counters accumulated while watching.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+int run_watch(struct registry_t *registry, const struct watch_config_t *config, struct watch_stats_t *stats)
+{
+    struct watch_t            watch;
+    struct pipeline_config_t  pipeline_config;
+    struct sigaction          action;
+    struct snapshot_stamp_t   stamp;
+    struct pollfd             pfd;
+    char                     *buf;
+    long                      now;
+    long                      next_report;
+    int                       sock;
+    int                       loaded;
+    int                       ret = 0;
+
+    memset(stats, 0, sizeof(*stats));
+
+    if ((sock = open_proc_connector(config->rcvbuf_bytes)) == -1)
+    {
+        printf("Error: [run_watch] unable to subscribe to the proc connector (are you root?)\n");
+        return -1;
+    }
+
+    memset(&pipeline_config, 0, sizeof(pipeline_config));
+    pipeline_config.num_samplers        = config->num_samplers;
+    pipeline_config.max_tracked         = config->max_tracked;
+    pipeline_config.max_workloads       = config->max_workloads;
+    pipeline_config.queue_size          = QUEUE_SIZE;
+    pipeline_config.chunk_size          = CHUNK_SIZE;
+    pipeline_config.train_samples       = config->train_samples;
+    pipeline_config.sample_rate         = config->sample_rate;
+    pipeline_config.rollup_thresh_pages = config->rollup_thresh_pages;
+    pipeline_config.history             = config->history;
+
+    if ((buf = (char *) malloc(RECV_BUF_SIZE)) == NULL)
+    {
+        printf("Error: unable to allocate enough memory\n");
+        close(sock);
+        return -1;
+    }
+
+    // The pipeline is the only writer of stdout from here on.
+    fflush(stdout);
+    if ((watch.pipeline = create_pipeline(registry, &pipeline_config, stdout)) == NULL)
+    {
+        printf("Error: [run_watch] unable to start the monitoring pipeline\n");
+        free(buf);
+        close(sock);
+        return -1;
+    }
+
+    watch.stats    = stats;
+    watch.registry = registry;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &handle_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    pfd.fd      = sock;
+    pfd.events  = POLLIN;
+    next_report = now_ms() + config->report_interval_ms;
+    stop_requested = 0;
+
+    // Remember the snapshot the caller started from, so only snapshots
+    // installed from now on are reloaded.
+    memset(&stamp, 0, sizeof(stamp));
+    if (config->snapshot_path != NULL)
+        snapshot_changed(config->snapshot_path, &stamp);
+
+    // This thread only discovers processes; sampling, classification and
+    // output all happen in the pipeline.
+    while (!stop_requested)
+    {
+        now = now_ms();
+
+        if ((poll(&pfd, 1, next_report > now ? next_report - now : 0) > 0) &&
+            (drain_events(&watch, sock, buf) == -1))
+        {
+            fprintf(stderr, "Error: [run_watch] failed to receive events\n");
+            ret = -1;
+            break;
+        }
+
+        if ((now = now_ms()) >= next_report)
+        {
+            update_stats(&watch);
+            print_watch_stats(stats);
+            next_report = now + config->report_interval_ms;
+
+            // Pick up models trained elsewhere. Loading updates each slot
+            // under its seqlock, so this is safe while the models are read.
+            if ((config->snapshot_path != NULL) && snapshot_changed(config->snapshot_path, &stamp))
+            {
+                loaded = load_registry(registry, config->snapshot_path);
+                fprintf(stderr, "Reloaded %d workload models from %s\n", loaded < 0 ? 0 : loaded,
+                    config->snapshot_path);
+            }
+        }
+    }
+
+    // Let the pipeline drain before taking the final counters.
+    watch.pipeline->stop(watch.pipeline);
+    update_stats(&watch);
+    delete_pipeline(watch.pipeline);
+    free(buf);
+    close(sock);
+    return ret;
+}
@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/queue.h"
+
+//-----------------------------------------------------------------------------
+// Size of a cache line. The producer and consumer positions are kept on
+// separate cache lines so pushes and pops don't slow each other down.
+//-----------------------------------------------------------------------------
+#define CACHE_LINE_SIZE (64)
+
+//-----------------------------------------------------------------------------
+// Private data members of queue_t object. This is Dmitry Vyukov's bounded
+// MPMC queue: every cell carries a sequence number that tells producers and
+// consumers whether it is free for the current lap around the ring, so a
+// single compare-and-swap on a position claims a cell.
+//
+// Each cell is a size_t sequence number followed by the item bytes.
+//-----------------------------------------------------------------------------
+struct queue_data_t
+{
+    char   *cells;
+    size_t  cell_size;
+    size_t  item_size;
+    size_t  mask;
+    char    pad0[CACHE_LINE_SIZE];
+    size_t  enqueue_pos;
+    char    pad1[CACHE_LINE_SIZE - sizeof(size_t)];
+    size_t  dequeue_pos;
+    char    pad2[CACHE_LINE_SIZE - sizeof(size_t)];
+};
+
+//-----------------------------------------------------------------------------
+// The queue object and its private data live in a single allocation.
+//-----------------------------------------------------------------------------
+struct queue_block_t
+{
+    struct queue_t      queue;
+    struct queue_data_t data;
+};
+
+#define CELL_SEQ(data, pos)  ((size_t *) ((data)->cells + ((pos) & (data)->mask) * (data)->cell_size))
+#define CELL_ITEM(seq)       ((char *) (seq) + sizeof(size_t))
+
+//-----------------------------------------------------------------------------
+// Copy an item to the back of the queue.
+//
+// @param queue the queue object.
+// @param item the item to push, item_size bytes long.
+// @return On success, returns 0. If the queue is full, returns -1.
+//-----------------------------------------------------------------------------
+static int push(struct queue_t *queue, const void *item)
+{
+    struct queue_data_t *data = queue->data;
+    size_t               pos  = __atomic_load_n(&data->enqueue_pos, __ATOMIC_RELAXED);
+    size_t              *seq;
+    long                 dif;
+
+    for (;;)
+    {
+        seq = CELL_SEQ(data, pos);
+        dif = (long) __atomic_load_n(seq, __ATOMIC_ACQUIRE) - (long) pos;
+
+        // The cell is free for this lap; try to claim it.
+        if (dif == 0)
+        {
+            if (__atomic_compare_exchange_n(&data->enqueue_pos, &pos, pos + 1, 1,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        // The cell still holds an item from the previous lap.
+        else if (dif < 0)
+            return -1;
+        // Another producer claimed the cell first.
+        else
+            pos = __atomic_load_n(&data->enqueue_pos, __ATOMIC_RELAXED);
+    }
+
+    memcpy(CELL_ITEM(seq), item, data->item_size);
+    __atomic_store_n(seq, pos + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Copy the item at the front of the queue out and remove it.
+//
+// @param queue the queue object.
+// @param item on success, will hold the item, item_size bytes long.
+// @return On success, returns 0. If the queue is empty, returns -1.
+//-----------------------------------------------------------------------------
+static int pop(struct queue_t *queue, void *item)
+{
+    struct queue_data_t *data = queue->data;
+    size_t               pos  = __atomic_load_n(&data->dequeue_pos, __ATOMIC_RELAXED);
+    size_t              *seq;
+    long                 dif;
+
+    for (;;)
+    {
+        seq = CELL_SEQ(data, pos);
+        dif = (long) __atomic_load_n(seq, __ATOMIC_ACQUIRE) - (long) (pos + 1);
+
+        // The cell holds an item for this lap; try to claim it.
+        if (dif == 0)
+        {
+            if (__atomic_compare_exchange_n(&data->dequeue_pos, &pos, pos + 1, 1,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        // No producer has filled the cell yet.
+        else if (dif < 0)
+            return -1;
+        // Another consumer claimed the cell first.
+        else
+            pos = __atomic_load_n(&data->dequeue_pos, __ATOMIC_RELAXED);
+    }
+
+    memcpy(item, CELL_ITEM(seq), data->item_size);
+    // Mark the cell free for the producers' next lap.
+    __atomic_store_n(seq, pos + data->mask + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Create a new queue object.
+//
+// @param capacity maximum number of items in the queue, rounded up to a power of 2.
+// @param item_size size of each item in bytes.
+//-----------------------------------------------------------------------------
+struct queue_t *create_queue(size_t capacity, size_t item_size)
+{
+    struct queue_block_t *block;
+    struct queue_data_t  *data;
+    size_t                cells = 2;
+
+    while (cells < capacity)
+        cells *= 2;
+
+    if ((block = (struct queue_block_t *) malloc(sizeof(struct queue_block_t))) == NULL)
+        return NULL;
+
+    data = &block->data;
+    block->queue.data = data;
+
+    // Keep every sequence number aligned.
+    data->item_size = item_size;
+    data->cell_size = (sizeof(size_t) + item_size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+    data->mask      = cells - 1;
+
+    if ((data->cells = (char *) malloc(cells * data->cell_size)) == NULL)
+    {
+        free(block);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < cells; i++)
+        *CELL_SEQ(data, i) = i;
+
+    data->enqueue_pos = 0;
+    data->dequeue_pos = 0;
+
+    // Attach public methods.
+    block->queue.push = &push;
+    block->queue.pop  = &pop;
+
+    return &block->queue;
+}
+
+//-----------------------------------------------------------------------------
+// Free up the resources allocated for a queue object.
+//-----------------------------------------------------------------------------
+void delete_queue(struct queue_t *queue)
+{
+    if (queue != NULL)
+    {
+        free(queue->data->cells);
+        // The queue is the first member of its block, so this frees the
+        // private data as well.
+        free(queue);
+    }
+}
@@ -65,3 +65,76 @@ double norm_rand(double mu, double sigma)
     return sigma * std_norm_rand() + mu;
 }
 
+//-----------------------------------------------------------------------------
+// Rotates x left by k bits.
+//-----------------------------------------------------------------------------
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+//-----------------------------------------------------------------------------
+// Seeds a pseudo random number generator. The seed is expanded into the four
+// words of state with splitmix64, as recommended by the xoshiro authors, so
+// that similar seeds still give unrelated sequences.
+//
+// @param rng the generator to seed.
+// @param seed any value; equal seeds give equal sequences.
+//-----------------------------------------------------------------------------
+void seed_rng(struct rng_t *rng, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        rng->s[i] = z ^ (z >> 31);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Generates a random number uniformly distributed in [0, 1). This is
+// xoshiro256** (see https://prng.di.unimi.it/); the top 53 bits of its
+// output fill the mantissa of a double.
+//
+// @param rng the generator to draw from.
+//-----------------------------------------------------------------------------
+double uniform_rand_r(struct rng_t *rng)
+{
+    uint64_t *s      = rng->s;
+    uint64_t  result = rotl(s[1] * 5, 7) * 9;
+    uint64_t  t      = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return (result >> 11) * 0x1.0p-53;
+}
+
+//-----------------------------------------------------------------------------
+// Generates a random number from the normal distribution with mean mu and
+// standard deviation sigma, drawing from a seeded generator. Uses the same
+// Marsaglia polar method as std_norm_rand.
+//
+// @param rng the generator to draw from.
+// @param mu the mean of the normal distribution to be sampled.
+// @param sigma the standard deviation of the normal distribution to be sampled
+//-----------------------------------------------------------------------------
+double norm_rand_r(struct rng_t *rng, double mu, double sigma)
+{
+    double x, y, s;
+
+    do
+    {
+        x = 2 * uniform_rand_r(rng) - 1.0;
+        y = 2 * uniform_rand_r(rng) - 1.0;
+        s = (x * x) + (y * y);
+    }
+    while ((s <= 0) || (s >= 1.0));
+
+    return sigma * x * sqrt(-2 * log(s) / s) + mu;
+}
@@ -0,0 +1,438 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "../include/registry.h"
+#include "../include/classifier.h"
+#include "../include/arena.h"
+#include "../include/snapshot.h"
+
+//-----------------------------------------------------------------------------
+// Private data members of registry_t object. The classifier parameters are
+// stored as a struct of arrays indexed by slot. Classification only ever
+// reads the upper array, which holds the largest sample that is still within
+// the class (mean + GAUSSIAN_OCC_Z_THRESH * stddev). An untrained workload
+// has a mean and standard deviation of 0 and an infinite upper bound.
+//
+// Concurrency: writers are serialized by lock. Readers never block:
+// - upper[slot] is a single aligned 8-byte word that writers publish with one
+//   atomic store, so a reader sees either the old or the new model.
+// - mean[slot] and stddev[slot] are guarded by the sequence counter seq[slot]
+//   which is odd while a write is in progress. Readers retry until they see
+//   the same even value before and after reading both.
+// - a slot is published in the hash table only after its key and parameters
+//   have been written.
+//-----------------------------------------------------------------------------
+struct registry_data_t
+{
+    struct arena_t   *arena;      // arena owning all the arrays below
+    size_t            capacity;   // maximum number of workloads
+    size_t            count;      // number of workloads added so far
+    size_t            table_mask; // number of hash table buckets minus one
+    int              *table;      // open addressing hash table of slots (-1 = empty)
+    char            (*keys)[REGISTRY_KEY_LEN];
+    double           *mean;
+    double           *stddev;
+    double           *upper;
+    unsigned         *seq;
+    pthread_mutex_t   lock;       // serializes writers
+};
+
+//-----------------------------------------------------------------------------
+// The registry object and its private data live in a single allocation.
+//-----------------------------------------------------------------------------
+struct registry_block_t
+{
+    struct registry_t      registry;
+    struct registry_data_t data;
+};
+
+//-----------------------------------------------------------------------------
+// FNV-1a hash of the first REGISTRY_KEY_LEN - 1 bytes of a key.
+//-----------------------------------------------------------------------------
+static size_t hash_key(const char *key)
+{
+    size_t hash = 14695981039346656037UL;
+
+    for (int i = 0; (i < REGISTRY_KEY_LEN - 1) && (key[i] != '\0'); i++)
+    {
+        hash ^= (unsigned char) key[i];
+        hash *= 1099511628211UL;
+    }
+
+    return hash;
+}
+
+//-----------------------------------------------------------------------------
+// Find the slot of a workload.
+//
+// @param registry the registry object.
+// @param key the workload identifier.
+// @return the slot of the workload, or -1 if it has not been added.
+//-----------------------------------------------------------------------------
+static int lookup(struct registry_t *registry, const char *key)
+{
+    struct registry_data_t *data = registry->data;
+    size_t                  h    = hash_key(key) & data->table_mask;
+    int                     slot;
+
+    while ((slot = __atomic_load_n(&data->table[h], __ATOMIC_ACQUIRE)) != -1)
+    {
+        if (strncmp(data->keys[slot], key, REGISTRY_KEY_LEN - 1) == 0)
+            return slot;
+        h = (h + 1) & data->table_mask;
+    }
+
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+// Publish new parameters for a slot. Must be called with the lock held.
+//-----------------------------------------------------------------------------
+static void write_params(struct registry_data_t *data, int slot, double mean, double stddev, double upper)
+{
+    unsigned seq = data->seq[slot];
+
+    __atomic_store_n(&data->seq[slot], seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    __atomic_store(&data->mean[slot], &mean, __ATOMIC_RELAXED);
+    __atomic_store(&data->stddev[slot], &stddev, __ATOMIC_RELAXED);
+    __atomic_store(&data->upper[slot], &upper, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&data->seq[slot], seq + 2, __ATOMIC_RELEASE);
+}
+
+//-----------------------------------------------------------------------------
+// Add a workload to the registry.
+//
+// @param registry the registry object.
+// @param key the workload identifier.
+// @return the slot of the workload, or -1 if the registry is full.
+//-----------------------------------------------------------------------------
+static int add(struct registry_t *registry, const char *key)
+{
+    struct registry_data_t *data = registry->data;
+    size_t                  h;
+    int                     slot;
+
+    pthread_mutex_lock(&data->lock);
+
+    if (((slot = lookup(registry, key)) == -1) && (data->count < data->capacity))
+    {
+        slot = (int) data->count;
+
+        strncpy(data->keys[slot], key, REGISTRY_KEY_LEN - 1);
+        data->keys[slot][REGISTRY_KEY_LEN - 1] = '\0';
+
+        // An untrained workload accepts every sample.
+        write_params(data, slot, 0, 0, INFINITY);
+
+        for (h = hash_key(key) & data->table_mask; data->table[h] != -1; h = (h + 1) & data->table_mask)
+            ;
+
+        __atomic_store_n(&data->table[h], slot, __ATOMIC_RELEASE);
+        __atomic_store_n(&data->count, data->count + 1, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&data->lock);
+    return slot;
+}
+
+//-----------------------------------------------------------------------------
+// Set the classifier parameters of a workload directly. Non-finite or
+// negative parameters are rejected, since they would either pass for a model
+// in is_trained or flag every sample.
+//-----------------------------------------------------------------------------
+static int set_params(struct registry_t *registry, int slot, double mean, double stddev)
+{
+    struct registry_data_t *data = registry->data;
+
+    if (!isfinite(mean) || !isfinite(stddev) || (stddev < 0))
+        return -1;
+
+    pthread_mutex_lock(&data->lock);
+    write_params(data, slot, mean, stddev, mean + GAUSSIAN_OCC_Z_THRESH * stddev);
+    pthread_mutex_unlock(&data->lock);
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Train (or retrain) the classifier of a workload.
+//-----------------------------------------------------------------------------
+static void train(struct registry_t *registry, int slot, double samples[], size_t num_samples)
+{
+    double mean;
+    double stddev;
+
+    // Fit outside the lock so readers and other writers are held up only for
+    // the few stores that publish the result. A fit that overflowed is
+    // rejected by set_params, leaving the previous model in place.
+    gaussian_occ_fit(samples, num_samples, &mean, &stddev);
+    set_params(registry, slot, mean, stddev);
+}
+
+//-----------------------------------------------------------------------------
+// Check whether a workload has a model. Only untrained workloads have an
+// infinite upper bound, since set_params accepts only finite parameters.
+//-----------------------------------------------------------------------------
+static int is_trained(struct registry_t *registry, int slot)
+{
+    double upper;
+
+    __atomic_load(&registry->data->upper[slot], &upper, __ATOMIC_RELAXED);
+    return isfinite(upper);
+}
+
+//-----------------------------------------------------------------------------
+// Get a consistent copy of the classifier parameters of a workload.
+//-----------------------------------------------------------------------------
+static void get_params(struct registry_t *registry, int slot, double *mean, double *stddev)
+{
+    struct registry_data_t *data = registry->data;
+    unsigned                before;
+    unsigned                after;
+
+    do
+    {
+        before = __atomic_load_n(&data->seq[slot], __ATOMIC_ACQUIRE);
+        __atomic_load(&data->mean[slot], mean, __ATOMIC_RELAXED);
+        __atomic_load(&data->stddev[slot], stddev, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&data->seq[slot], __ATOMIC_RELAXED);
+    }
+    while ((before & 1) || (before != after));
+}
+
+//-----------------------------------------------------------------------------
+// Predict whether a sample is within the class of a workload. Comparing
+// against the precomputed upper bound is equivalent to the z-score test of
+// the gaussian one class classifier.
+//-----------------------------------------------------------------------------
+static int classify(struct registry_t *registry, int slot, double sample)
+{
+    double upper;
+
+    __atomic_load(&registry->data->upper[slot], &upper, __ATOMIC_RELAXED);
+    return sample > upper ? 0 : 1;
+}
+
+//-----------------------------------------------------------------------------
+// Classify many samples at once. This is a plain gather-and-compare loop
+// with no calls or branches so the compiler can vectorize it. Plain loads of
+// upper are fine here since each element is a single aligned word.
+//-----------------------------------------------------------------------------
+static void classify_batch(struct registry_t *registry, const int slots[], const double samples[],
+    int predictions[], size_t num_samples)
+{
+    const double *upper = registry->data->upper;
+
+    for (size_t i = 0; i < num_samples; i++)
+    {
+        predictions[i] = !(samples[i] > upper[slots[i]]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Number of workloads in the registry.
+//-----------------------------------------------------------------------------
+static size_t size(struct registry_t *registry)
+{
+    return __atomic_load_n(&registry->data->count, __ATOMIC_ACQUIRE);
+}
+
+//-----------------------------------------------------------------------------
+// Get the identifier of the workload in a slot.
+//-----------------------------------------------------------------------------
+static const char *get_key(struct registry_t *registry, int slot)
+{
+    return registry->data->keys[slot];
+}
+
+//-----------------------------------------------------------------------------
+// Create a new registry object able to hold up to capacity workloads.
+//-----------------------------------------------------------------------------
+struct registry_t *create_registry(size_t capacity)
+{
+    struct registry_block_t *block;
+    struct registry_data_t  *data;
+    size_t                   buckets = 1;
+    size_t                   bytes;
+
+    if (capacity == 0)
+        return NULL;
+
+    // Keep the hash table at most half full.
+    while (buckets < 2 * capacity)
+        buckets *= 2;
+
+    // Size the arena so that all the arrays fit in its first chunk.
+    bytes = buckets * sizeof(int)
+        + capacity * (REGISTRY_KEY_LEN + 3 * sizeof(double) + sizeof(unsigned))
+        + 8 * ARENA_ALIGNMENT;
+
+    if ((block = (struct registry_block_t *) malloc(sizeof(struct registry_block_t))) == NULL)
+        return NULL;
+
+    data = &block->data;
+    block->registry.data = data;
+
+    if ((data->arena = create_arena(bytes)) == NULL)
+    {
+        free(block);
+        return NULL;
+    }
+
+    data->capacity   = capacity;
+    data->count      = 0;
+    data->table_mask = buckets - 1;
+    data->table      = (int *) data->arena->alloc(data->arena, buckets * sizeof(int));
+    data->keys       = data->arena->alloc(data->arena, capacity * REGISTRY_KEY_LEN);
+    data->mean       = (double *) data->arena->alloc(data->arena, capacity * sizeof(double));
+    data->stddev     = (double *) data->arena->alloc(data->arena, capacity * sizeof(double));
+    data->upper      = (double *) data->arena->alloc(data->arena, capacity * sizeof(double));
+    data->seq        = (unsigned *) data->arena->alloc(data->arena, capacity * sizeof(unsigned));
+
+    if ((data->table == NULL) || (data->keys == NULL) || (data->mean == NULL) ||
+        (data->stddev == NULL) || (data->upper == NULL) || (data->seq == NULL))
+    {
+        delete_arena(data->arena);
+        free(block);
+        return NULL;
+    }
+
+    memset(data->table, -1, buckets * sizeof(int));
+    memset(data->seq, 0, capacity * sizeof(unsigned));
+    pthread_mutex_init(&data->lock, NULL);
+
+    // Attach public methods.
+    block->registry.lookup         = &lookup;
+    block->registry.add            = &add;
+    block->registry.train          = &train;
+    block->registry.set_params     = &set_params;
+    block->registry.is_trained     = &is_trained;
+    block->registry.get_params     = &get_params;
+    block->registry.classify       = &classify;
+    block->registry.classify_batch = &classify_batch;
+    block->registry.size           = &size;
+    block->registry.get_key        = &get_key;
+
+    return &block->registry;
+}
+
+//-----------------------------------------------------------------------------
+// Free up the resources allocated for a registry object.
+//-----------------------------------------------------------------------------
+void delete_registry(struct registry_t *registry)
+{
+    if (registry != NULL)
+    {
+        pthread_mutex_destroy(&registry->data->lock);
+        delete_arena(registry->data->arena);
+        // The registry is the first member of its block, so this frees the
+        // private data as well.
+        free(registry);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Save the parameters of every trained workload in the registry to a snapshot
+// file. The payload mirrors the registry layout: num_records keys followed by
+// num_records means and num_records standard deviations. Untrained workloads
+// are left out, since loading their zero parameters would make them reject
+// every sample.
+//
+// @param registry the registry object.
+// @param path where to install the snapshot.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+int save_registry(struct registry_t *registry, const char *path)
+{
+    size_t  size = registry->size(registry);
+    size_t  count = 0;
+    size_t  payload_size;
+    char   *payload;
+    char  (*keys)[REGISTRY_KEY_LEN];
+    double *mean;
+    double *stddev;
+    int     ret;
+
+    for (int slot = 0; slot < size; slot++)
+        count += registry->is_trained(registry, slot);
+
+    payload_size = count * (REGISTRY_KEY_LEN + 2 * sizeof(double));
+    if ((payload = (char *) calloc(1, payload_size > 0 ? payload_size : 1)) == NULL)
+        return -1;
+
+    keys   = (char (*)[REGISTRY_KEY_LEN]) payload;
+    mean   = (double *) (payload + count * REGISTRY_KEY_LEN);
+    stddev = mean + count;
+
+    // A workload trained since the count above is left for the next save.
+    for (int slot = 0, i = 0; (slot < size) && (i < count); slot++)
+    {
+        if (!registry->is_trained(registry, slot))
+            continue;
+
+        strcpy(keys[i], registry->get_key(registry, slot));
+        registry->get_params(registry, slot, &mean[i], &stddev[i]);
+        i++;
+    }
+
+    ret = write_snapshot(path, SNAPSHOT_KIND_REGISTRY, count, payload, payload_size);
+    free(payload);
+    return ret;
+}
+
+//-----------------------------------------------------------------------------
+// Load workload parameters from a snapshot file into the registry.
+//
+// @param registry the registry object.
+// @param path the snapshot file.
+// @return On success, returns the number of workloads loaded. On error, returns -1.
+//-----------------------------------------------------------------------------
+int load_registry(struct registry_t *registry, const char *path)
+{
+    struct snapshot_t     snapshot;
+    size_t                count;
+    const char          (*keys)[REGISTRY_KEY_LEN];
+    const double         *mean;
+    const double         *stddev;
+    int                   slot;
+    int                   loaded = 0;
+
+    if (map_snapshot(path, SNAPSHOT_KIND_REGISTRY, &snapshot) == -1)
+        return -1;
+
+    count = snapshot.header->num_records;
+
+    if (snapshot.header->payload_size != count * (REGISTRY_KEY_LEN + 2 * sizeof(double)))
+    {
+        unmap_snapshot(&snapshot);
+        return -1;
+    }
+
+    keys   = (const char (*)[REGISTRY_KEY_LEN]) snapshot.payload;
+    mean   = (const double *) ((const char *) snapshot.payload + count * REGISTRY_KEY_LEN);
+    stddev = mean + count;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // Keys are null terminated by save_registry, but don't trust the file.
+        if (memchr(keys[i], '\0', REGISTRY_KEY_LEN) == NULL)
+            continue;
+
+        // Neither are the parameters: a NaN would otherwise count as trained.
+        if (!isfinite(mean[i]) || !isfinite(stddev[i]) || (stddev[i] < 0))
+            continue;
+
+        if ((slot = registry->add(registry, keys[i])) == -1)
+            break;
+
+        registry->set_params(registry, slot, mean[i], stddev[i]);
+        loaded++;
+    }
+
+    unmap_snapshot(&snapshot);
+    return loaded;
+}
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../include/sim.h"
+#include "../include/rand_util.h"
+#include "../include/classifier.h"
+#include "../include/stats_util.h"
+#include "../include/arena.h"
+#include "../include/score_pipeline.h"
+
+//-----------------------------------------------------------------------------
+// Number of samples drawn and scored at a time.
+//-----------------------------------------------------------------------------
+#define SIM_BATCH_SIZE (256)
+
+//-----------------------------------------------------------------------------
+// Sink of the simulation: tallies the confusion matrix and, if an output
+// file was given, writes every sample to it.
+//-----------------------------------------------------------------------------
+struct sim_sink_t
+{
+    struct counts_sink_t counts;
+    struct writer_sink_t writer;
+};
+
+static inline void sim_sink(struct sim_sink_t *sink, size_t i, double x, int actual, int predicted)
+{
+    counts_sink(&sink->counts, i, x, actual, predicted);
+    if (sink->writer.out != NULL)
+        writer_sink(&sink->writer, i, x, actual, predicted);
+}
+
+//-----------------------------------------------------------------------------
+// Scores a batch of measured peaks with the inlined equivalents of classify
+// and add_stat.
+//-----------------------------------------------------------------------------
+DEFINE_SCORE_PIPELINE(score_peaks, unsigned long, peak, zscore, sim)
+
+//-----------------------------------------------------------------------------
+// Draws the peak memory usage the sampler would have measured for sample
+// iter, in pages.
+//-----------------------------------------------------------------------------
+static unsigned long measure(const struct sim_config_t *config, struct rng_t *rng, long iter)
+{
+    double peak = iter < config->thresh
+        ? norm_rand_r(rng, config->mu_1, config->sigma_1)
+        : norm_rand_r(rng, config->mu_2, config->sigma_2);
+
+    // A child asked to allocate a negative amount fails to allocate anything.
+    if (peak < 0)
+        peak = 0;
+
+    if (config->noise_sigma > 0)
+        peak = norm_rand_r(rng, peak, config->noise_sigma);
+
+    if ((config->miss_prob > 0) && (uniform_rand_r(rng) < config->miss_prob))
+        peak *= uniform_rand_r(rng);
+
+    return peak < 0 ? 0 : (unsigned long) peak;
+}
+
+//-----------------------------------------------------------------------------
+// Run the train/classify/stats pipeline of ./main in-process.
+//
+// @param config settings for the run.
+// @param stats statistics object the classifications are recorded in.
+// @param out if not NULL, receives one "iter peak prediction" line per sample.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+int run_sim(const struct sim_config_t *config, struct stats_t *stats, FILE *out)
+{
+    struct rng_t           rng;
+    struct arena_t        *arena;
+    struct gaussian_occ_t *classifier;
+    struct sample_buf_t    train_samples;
+    struct zscore_scorer_t scorer;
+    struct sim_sink_t      sink;
+    unsigned long          peaks[SIM_BATCH_SIZE];
+    int                    actual[SIM_BATCH_SIZE];
+    unsigned long          mem_usage;
+    double                 mean;
+    double                 stddev;
+    size_t                 n;
+
+    if ((config->train_samples == 0) || (config->total_samples <= config->train_samples) ||
+        ((arena = create_arena(ARENA_DEFAULT_CHUNK_SIZE)) == NULL))
+        return -1;
+
+    if (((classifier = create_classifier_in(arena)) == NULL) ||
+        (init_sample_buf(&train_samples, arena, config->train_samples) == -1))
+    {
+        delete_arena(arena);
+        return -1;
+    }
+
+    seed_rng(&rng, config->seed);
+    init_counts_sink(&sink.counts);
+
+    // Train the classifier on the leading samples, exactly like main.
+    for (size_t iter = 0; iter < config->train_samples; iter++)
+    {
+        mem_usage = measure(config, &rng, iter);
+        if (sample_buf_push(&train_samples, mem_usage) == -1)
+        {
+            delete_arena(arena);
+            return -1;
+        }
+
+        if (out != NULL)
+            fprintf(out, "%zu %lu 1\n", iter, mem_usage);
+    }
+
+    classifier->train(classifier, train_samples.samples, train_samples.len);
+    gaussian_occ_get_params(classifier, &mean, &stddev);
+    init_zscore_scorer(&scorer, mean, stddev, GAUSSIAN_OCC_Z_THRESH);
+
+    // Classify the rest against the distribution they were drawn from. The
+    // samples are drawn in the same order as one at a time, so batching
+    // doesn't change the results.
+    for (size_t first = config->train_samples; first < config->total_samples; first += n)
+    {
+        n = config->total_samples - first < SIM_BATCH_SIZE ? config->total_samples - first : SIM_BATCH_SIZE;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            peaks[i]  = measure(config, &rng, first + i);
+            actual[i] = (long) (first + i) < config->thresh ? 1 : 0;
+        }
+
+        init_writer_sink(&sink.writer, out, first);
+        score_peaks(peaks, actual, n, 0, &scorer, &sink);
+    }
+
+    flush_counts_sink(&sink.counts, stats);
+    delete_arena(arena);
+    return 0;
+}
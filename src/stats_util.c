@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "../include/stats_util.h"
+#include "../include/arena.h"
 
 //-----------------------------------------------------------------------------
 // Private data members of stats_t object.
@@ -32,6 +33,24 @@ static void add_stat(struct stats_t *stats, int actual, int predicted)
         stats->data->tn++;
 }
 
+//-----------------------------------------------------------------------------
+// Add counts of statistics tallied elsewhere, e.g. by a specialized pipeline.
+//
+// @param stats the stats object.
+// @param tp number of true positives.
+// @param fn number of false negatives.
+// @param fp number of false positives.
+// @param tn number of true negatives.
+//-----------------------------------------------------------------------------
+static void add_counts(struct stats_t *stats, unsigned long tp, unsigned long fn,
+    unsigned long fp, unsigned long tn)
+{
+    stats->data->tp += tp;
+    stats->data->fn += fn;
+    stats->data->fp += fp;
+    stats->data->tn += tn;
+}
+
 //-----------------------------------------------------------------------------
 // Prints the Confusion Matrix base on the current statistics.
 //----------------------------------------------------------------------------- 
@@ -92,23 +111,24 @@ static void print_confusion_matrix(struct stats_t *stats)
 }
 
 //-----------------------------------------------------------------------------
-// Allocate and initialize stats_t object.
+// The stats object and its private data live in a single allocation.
 //-----------------------------------------------------------------------------
-struct stats_t *create_stats(void)
+struct stats_block_t
 {
-    // Allocate memory.
-    struct stats_t *stats = (struct stats_t *) malloc(sizeof(struct stats_t));
+    struct stats_t      stats;
+    struct stats_data_t data;
+};
 
-    if (stats == NULL)
+//-----------------------------------------------------------------------------
+// Initialize a freshly allocated stats block.
+//-----------------------------------------------------------------------------
+static struct stats_t *init_stats(struct stats_block_t *block)
+{
+    if (block == NULL)
         return NULL;
 
-    stats->data = (struct stats_data_t *) malloc(sizeof(struct stats_data_t));
-
-    if (stats->data == NULL)
-    {
-        delete_stats(stats);
-        return NULL;
-    }
+    struct stats_t *stats = &block->stats;
+    stats->data = &block->data;
 
     // Initialize state
     stats->data->tp = 0;
@@ -118,6 +138,7 @@ struct stats_t *create_stats(void)
 
     // Attach member functions
     stats->add_stat               = &add_stat;
+    stats->add_counts             = &add_counts;
     stats->print_confusion_matrix = &print_confusion_matrix;
     stats->get_accuracy           = &compute_accuracy;
     stats->get_recall             = &compute_recall;
@@ -127,17 +148,32 @@ struct stats_t *create_stats(void)
     return stats;
 }
 
+//-----------------------------------------------------------------------------
+// Allocate and initialize stats_t object.
+//-----------------------------------------------------------------------------
+struct stats_t *create_stats(void)
+{
+    // Allocate memory for the object and its private data together.
+    return init_stats((struct stats_block_t *) malloc(sizeof(struct stats_block_t)));
+}
+
+//-----------------------------------------------------------------------------
+// Allocate and initialize stats_t object inside an arena.
+//-----------------------------------------------------------------------------
+struct stats_t *create_stats_in(struct arena_t *arena)
+{
+    return init_stats((struct stats_block_t *) arena->alloc(arena, sizeof(struct stats_block_t)));
+}
+
 //-----------------------------------------------------------------------------
 // Deallocate dynamically allocated resources for stats_t object.
 //-----------------------------------------------------------------------------
 void delete_stats(struct stats_t *stats)
 {
+    // The stats object is the first member of its block, so this frees the
+    // private data as well.
     if (stats != NULL)
     {
-        if (stats->data != NULL)
-        {
-            free(stats->data);
-        }
         free(stats);
     }
 }
\ No newline at end of file
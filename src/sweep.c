@@ -0,0 +1,451 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "../include/sweep.h"
+#include "../include/sim.h"
+#include "../include/stats_util.h"
+#include "../include/rand_util.h"
+
+//-----------------------------------------------------------------------------
+// Maximum length of a configuration key and of a cache file line.
+//-----------------------------------------------------------------------------
+#define KEY_LEN  (256)
+#define LINE_LEN (512)
+
+//-----------------------------------------------------------------------------
+// Separates the configuration key from the results in a cache file line.
+//-----------------------------------------------------------------------------
+#define CACHE_SEPARATOR " | "
+
+//-----------------------------------------------------------------------------
+// One configuration of the sweep and its results.
+//-----------------------------------------------------------------------------
+struct cell_t
+{
+    struct sim_config_t config;
+    char                key[KEY_LEN];
+    int                 done;
+    double              accuracy;
+    double              recall;
+    double              precision;
+    double              f1_score;
+};
+
+//-----------------------------------------------------------------------------
+// State shared by the sweep workers.
+//-----------------------------------------------------------------------------
+struct sweep_t
+{
+    struct cell_t   *cells;
+    size_t           num_cells;
+    size_t           next_cell; // index of the next cell to claim
+    FILE            *cache;     // cache file opened for appending, or NULL
+    pthread_mutex_t  lock;      // serializes appends to the cache
+    int              failed;    // set if any simulation failed
+};
+
+//-----------------------------------------------------------------------------
+// Parses "name start [stop [step]]" into a range. A missing stop or step
+// leaves the range holding only start.
+//-----------------------------------------------------------------------------
+static int parse_range(const char *args, struct sweep_range_t *range)
+{
+    int n = sscanf(args, "%lf %lf %lf", &range->start, &range->stop, &range->step);
+
+    if (n < 1)
+        return -1;
+    if (n < 2)
+        range->stop = range->start;
+    if (n < 3)
+        range->step = 0;
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Read a sweep spec file.
+//
+// @param path the spec file.
+// @param spec on success, holds the sweep description.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+int parse_sweep_spec(const char *path, struct sweep_spec_t *spec)
+{
+    char                  line[LINE_LEN];
+    char                  name[32];
+    char                 *args;
+    FILE                 *fp;
+    int                   lineno = 0;
+    int                   n;
+    int                   ret = 0;
+    unsigned long long    u;
+    unsigned long long    v;
+
+    if ((fp = fopen(path, "r")) == NULL)
+    {
+        printf("Error: [parse_sweep_spec] failed to open %s\n", path);
+        return -1;
+    }
+
+    while ((ret == 0) && (fgets(line, sizeof(line), fp) != NULL))
+    {
+        lineno++;
+
+        if ((sscanf(line, "%31s%n", name, &n) != 1) || (name[0] == '#'))
+            continue;
+
+        args = line + n;
+
+        if (strcmp(name, "thresh") == 0)
+            ret = parse_range(args, &spec->thresh);
+        else if (strcmp(name, "mu_1") == 0)
+            ret = parse_range(args, &spec->mu_1);
+        else if (strcmp(name, "sigma_1") == 0)
+            ret = parse_range(args, &spec->sigma_1);
+        else if (strcmp(name, "mu_2") == 0)
+            ret = parse_range(args, &spec->mu_2);
+        else if (strcmp(name, "sigma_2") == 0)
+            ret = parse_range(args, &spec->sigma_2);
+        else if ((strcmp(name, "train") == 0) && (sscanf(args, "%llu", &u) == 1))
+            spec->train = u;
+        else if ((strcmp(name, "samples") == 0) && (sscanf(args, "%llu", &u) == 1))
+            spec->samples = u;
+        else if ((strcmp(name, "seed") == 0) && (sscanf(args, "%llu", &u) == 1))
+            spec->seed = u;
+        else if ((strcmp(name, "noise") == 0) && (sscanf(args, "%lf", &spec->noise_sigma) == 1))
+            ;
+        else if ((strcmp(name, "miss") == 0) && (sscanf(args, "%lf", &spec->miss_prob) == 1))
+            ;
+        else if ((strcmp(name, "random") == 0) && ((n = sscanf(args, "%llu %llu", &u, &v)) >= 1))
+        {
+            spec->random_count = u;
+            if (n == 2)
+                spec->random_seed = v;
+        }
+        else
+            ret = -1;
+
+        if (ret == -1)
+            printf("Error: [parse_sweep_spec] %s:%d: invalid setting '%s'\n", path, lineno, name);
+    }
+
+    fclose(fp);
+
+    // Only the samples after the training ones are scored.
+    if ((ret == 0) && (spec->samples <= spec->train))
+    {
+        printf("Error: [parse_sweep_spec] %s: samples must be larger than train\n", path);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+//-----------------------------------------------------------------------------
+// Number of values a range takes in a grid search.
+//-----------------------------------------------------------------------------
+static size_t range_count(const struct sweep_range_t *range)
+{
+    if ((range->step <= 0) || (range->stop <= range->start))
+        return 1;
+
+    // Allow for rounding errors so that stop itself is included.
+    return (size_t) floor((range->stop - range->start) / range->step + 1e-9) + 1;
+}
+
+//-----------------------------------------------------------------------------
+// The i-th value of a range in a grid search.
+//-----------------------------------------------------------------------------
+static double range_value(const struct sweep_range_t *range, size_t i)
+{
+    return range->start + i * range->step;
+}
+
+//-----------------------------------------------------------------------------
+// A random value from a range.
+//-----------------------------------------------------------------------------
+static double range_random(const struct sweep_range_t *range, struct rng_t *rng)
+{
+    if (range->stop <= range->start)
+        return range->start;
+    return range->start + (range->stop - range->start) * uniform_rand_r(rng);
+}
+
+//-----------------------------------------------------------------------------
+// Fills in the parts of a cell's configuration that every cell shares, and
+// the key the cell is cached under.
+//-----------------------------------------------------------------------------
+static void init_cell(const struct sweep_spec_t *spec, struct cell_t *cell)
+{
+    struct sim_config_t *config = &cell->config;
+
+    config->train_samples = spec->train;
+    config->total_samples = spec->samples;
+    config->seed          = spec->seed;
+    config->noise_sigma   = spec->noise_sigma;
+    config->miss_prob     = spec->miss_prob;
+
+    // Print doubles exactly so a key always maps back to the same cell.
+    snprintf(cell->key, sizeof(cell->key), "%ld %.17g %.17g %.17g %.17g %zu %zu %llu %.17g %.17g",
+        config->thresh, config->mu_1, config->sigma_1, config->mu_2, config->sigma_2,
+        config->train_samples, config->total_samples, (unsigned long long) config->seed,
+        config->noise_sigma, config->miss_prob);
+
+    cell->done = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Expands the spec into the list of cells to evaluate.
+//
+// @return the cells, or NULL if out of memory. num_cells is set on return.
+//-----------------------------------------------------------------------------
+static struct cell_t *expand_spec(const struct sweep_spec_t *spec, size_t *num_cells)
+{
+    const struct sweep_range_t *ranges[5] = {
+        &spec->thresh, &spec->mu_1, &spec->sigma_1, &spec->mu_2, &spec->sigma_2
+    };
+    size_t          counts[5];
+    size_t          idx;
+    double          values[5];
+    struct cell_t  *cells;
+    struct rng_t    rng;
+
+    if (spec->random_count > 0)
+        *num_cells = spec->random_count;
+    else
+    {
+        *num_cells = 1;
+        for (int p = 0; p < 5; p++)
+        {
+            counts[p] = range_count(ranges[p]);
+            *num_cells *= counts[p];
+        }
+    }
+
+    if ((cells = (struct cell_t *) malloc(*num_cells * sizeof(struct cell_t))) == NULL)
+        return NULL;
+
+    seed_rng(&rng, spec->random_seed);
+
+    for (size_t i = 0; i < *num_cells; i++)
+    {
+        // In a grid search, cell i is the mixed radix number whose digits
+        // index the values of each parameter, thresh varying slowest.
+        idx = i;
+        for (int p = 4; p >= 0; p--)
+        {
+            if (spec->random_count > 0)
+                values[p] = range_random(ranges[p], &rng);
+            else
+            {
+                values[p] = range_value(ranges[p], idx % counts[p]);
+                idx /= counts[p];
+            }
+        }
+
+        cells[i].config.thresh  = lround(values[0]);
+        cells[i].config.mu_1    = values[1];
+        cells[i].config.sigma_1 = values[2];
+        cells[i].config.mu_2    = values[3];
+        cells[i].config.sigma_2 = values[4];
+        init_cell(spec, &cells[i]);
+    }
+
+    return cells;
+}
+
+//-----------------------------------------------------------------------------
+// Orders cell pointers by key.
+//-----------------------------------------------------------------------------
+static int compare_keys(const void *a, const void *b)
+{
+    return strcmp((*(const struct cell_t **) a)->key, (*(const struct cell_t **) b)->key);
+}
+
+//-----------------------------------------------------------------------------
+// Marks the cells already present in the cache file as done, with their
+// cached results. Lines that don't parse (e.g. one cut short when a previous
+// sweep was interrupted) are ignored.
+//-----------------------------------------------------------------------------
+static void load_cache(struct sweep_t *sweep, const char *cache_path)
+{
+    struct cell_t   probe;
+    struct cell_t  *probe_ptr = &probe;
+    struct cell_t **sorted;
+    struct cell_t **found;
+    char            line[LINE_LEN];
+    char           *sep;
+    double          metrics[4];
+    FILE           *fp;
+
+    if ((fp = fopen(cache_path, "r")) == NULL)
+        return;
+
+    if ((sorted = (struct cell_t **) malloc(sweep->num_cells * sizeof(struct cell_t *))) == NULL)
+    {
+        fclose(fp);
+        return;
+    }
+
+    for (size_t i = 0; i < sweep->num_cells; i++)
+        sorted[i] = &sweep->cells[i];
+    qsort(sorted, sweep->num_cells, sizeof(struct cell_t *), &compare_keys);
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        if ((sep = strstr(line, CACHE_SEPARATOR)) == NULL)
+            continue;
+
+        if (sscanf(sep + strlen(CACHE_SEPARATOR), "%lf %lf %lf %lf",
+            &metrics[0], &metrics[1], &metrics[2], &metrics[3]) != 4)
+            continue;
+
+        *sep = '\0';
+        if (strlen(line) >= sizeof(probe.key))
+            continue;
+        strcpy(probe.key, line);
+
+        found = (struct cell_t **) bsearch(&probe_ptr, sorted, sweep->num_cells,
+            sizeof(struct cell_t *), &compare_keys);
+
+        if (found != NULL)
+        {
+            (*found)->done      = 1;
+            (*found)->accuracy  = metrics[0];
+            (*found)->recall    = metrics[1];
+            (*found)->precision = metrics[2];
+            (*found)->f1_score  = metrics[3];
+        }
+    }
+
+    free(sorted);
+    fclose(fp);
+}
+
+//-----------------------------------------------------------------------------
+// Sweep worker. Claims cells one at a time until none are left. Every cell
+// gets its own stats object and simulation state, so nothing is shared
+// between workers except the claim counter and the cache file.
+//-----------------------------------------------------------------------------
+static void *sweep_worker(void *arg)
+{
+    struct sweep_t *sweep = (struct sweep_t *) arg;
+    struct cell_t  *cell;
+    struct stats_t *stats;
+    size_t          i;
+
+    while ((i = __atomic_fetch_add(&sweep->next_cell, 1, __ATOMIC_RELAXED)) < sweep->num_cells)
+    {
+        cell = &sweep->cells[i];
+        if (cell->done)
+            continue;
+
+        if (((stats = create_stats()) == NULL) || (run_sim(&cell->config, stats, NULL) == -1))
+        {
+            delete_stats(stats);
+            __atomic_store_n(&sweep->failed, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        cell->accuracy  = stats->get_accuracy(stats);
+        cell->recall    = stats->get_recall(stats);
+        cell->precision = stats->get_precision(stats);
+        cell->f1_score  = stats->get_f1_score(stats);
+        cell->done      = 1;
+        delete_stats(stats);
+
+        // Flush every line so a sweep that is killed loses at most the cells
+        // that were still running.
+        if (sweep->cache != NULL)
+        {
+            pthread_mutex_lock(&sweep->lock);
+            fprintf(sweep->cache, "%s%s%.17g %.17g %.17g %.17g\n", cell->key, CACHE_SEPARATOR,
+                cell->accuracy, cell->recall, cell->precision, cell->f1_score);
+            fflush(sweep->cache);
+            pthread_mutex_unlock(&sweep->lock);
+        }
+    }
+
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Evaluate every configuration of a sweep in parallel.
+//
+// @param spec the sweep description.
+// @param num_jobs number of configurations evaluated at the same time.
+// @param cache_path file of finished configurations, or NULL.
+// @param out where the table is written.
+// @return On success, returns 0. On error, returns -1.
+//-----------------------------------------------------------------------------
+int run_sweep(const struct sweep_spec_t *spec, size_t num_jobs, const char *cache_path, FILE *out)
+{
+    struct sweep_t  sweep;
+    pthread_t      *threads;
+    size_t          started = 0;
+    size_t          cached = 0;
+
+    memset(&sweep, 0, sizeof(sweep));
+
+    if ((sweep.cells = expand_spec(spec, &sweep.num_cells)) == NULL)
+        return -1;
+
+    if ((threads = (pthread_t *) malloc((num_jobs > 0 ? num_jobs : 1) * sizeof(pthread_t))) == NULL)
+    {
+        free(sweep.cells);
+        return -1;
+    }
+
+    if (cache_path != NULL)
+    {
+        load_cache(&sweep, cache_path);
+        if ((sweep.cache = fopen(cache_path, "a")) == NULL)
+            printf("[run_sweep] Warning: unable to open cache %s\n", cache_path);
+    }
+
+    for (size_t i = 0; i < sweep.num_cells; i++)
+        cached += sweep.cells[i].done;
+
+    fprintf(stderr, "%zu configurations, %zu cached, %zu jobs\n", sweep.num_cells, cached, num_jobs);
+
+    pthread_mutex_init(&sweep.lock, NULL);
+
+    for (size_t i = 0; i < num_jobs; i++)
+    {
+        if (pthread_create(&threads[i], NULL, &sweep_worker, &sweep) != 0)
+            break;
+        started++;
+    }
+
+    // Run in this thread if no worker could be started.
+    if (started == 0)
+        sweep_worker(&sweep);
+
+    for (size_t i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&sweep.lock);
+    if (sweep.cache != NULL)
+        fclose(sweep.cache);
+
+    fprintf(out, "%8s %12s %12s %12s %12s %12s %12s %12s %12s\n",
+        "thresh", "mu_1", "sigma_1", "mu_2", "sigma_2", "accuracy", "recall", "precision", "f1");
+
+    for (size_t i = 0; i < sweep.num_cells; i++)
+    {
+        struct cell_t *cell = &sweep.cells[i];
+
+        if (!cell->done)
+            continue;
+
+        fprintf(out, "%8ld %12.4f %12.4f %12.4f %12.4f %12.8f %12.8f %12.8f %12.8f\n",
+            cell->config.thresh, cell->config.mu_1, cell->config.sigma_1,
+            cell->config.mu_2, cell->config.sigma_2,
+            cell->accuracy, cell->recall, cell->precision, cell->f1_score);
+    }
+
+    free(threads);
+    free(sweep.cells);
+    return sweep.failed ? -1 : 0;
+}